@@ -0,0 +1,23 @@
+#ifdef GL_ES
+precision mediump float;
+#endif
+
+uniform sampler2D al_tex;
+uniform sampler2D noise_tex;
+varying vec2 varying_texcoord;
+varying vec2 varying_noisecoord;
+varying vec4 varying_color;
+
+// Cheaper take on grain.glsl: the gaussian-distributed noise is generated once on the CPU
+// (see CreateNoiseBitmap in common.c), so all that's left per pixel is a texture fetch.
+
+#define INTENSITY 0.085
+// Peak of the gaussian the noise texture was normalized by.
+#define PEAK 1.5958
+
+void main() {
+    vec4 color = texture2D(al_tex, varying_texcoord) * varying_color;
+    float noise = texture2D(noise_tex, fract(varying_noisecoord)).r * float(PEAK);
+    color.rgb += noise * (1.0 - color.rgb) * float(INTENSITY);
+    gl_FragColor = color;
+}
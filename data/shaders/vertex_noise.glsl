@@ -0,0 +1,30 @@
+attribute vec4 al_pos;
+attribute vec4 al_color;
+attribute vec2 al_texcoord;
+uniform mat4 al_projview_matrix;
+uniform bool al_use_tex_matrix;
+uniform mat4 al_tex_matrix;
+varying vec4 varying_color;
+varying vec2 varying_texcoord;
+varying vec2 varying_noisecoord;
+varying vec4 varying_pos;
+
+uniform float time;
+uniform vec2 noise_scale; // framebuffer size divided by noise texture size
+
+void main() {
+	varying_color = al_color;
+	if (al_use_tex_matrix) {
+		vec4 uv = al_tex_matrix * vec4(al_texcoord, 0, 1);
+		varying_texcoord = uv.xy;
+	} else {
+		varying_texcoord = al_texcoord;
+	}
+
+	// jump to a random place in the noise texture every frame; done per vertex, so it costs nothing
+	vec2 offset = fract(sin(vec2(time, time + 1.0) * vec2(12.9898, 78.233)) * 43758.5453);
+	varying_noisecoord = varying_texcoord * noise_scale + offset;
+
+	varying_pos = al_projview_matrix * al_pos;
+	gl_Position = varying_pos;
+}
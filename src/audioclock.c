@@ -0,0 +1,233 @@
+/*! \file audioclock.c
+ *  \brief Playback positions of audio streams, taken from the mixers.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+static void MixerClockCallback(void* buffer, unsigned int samples, void* userdata) {
+	// Runs on the audio thread after every fragment. Readers retry whenever the sequence number
+	// was odd or changed while they were reading.
+	struct MixerClock* clock = userdata;
+	unsigned int seq = __atomic_load_n(&clock->seq, __ATOMIC_RELAXED);
+	__atomic_store_n(&clock->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&clock->frames, clock->frames + samples, __ATOMIC_RELAXED);
+	__atomic_store_n(&clock->time, (int64_t)(al_get_time() * 1000000.0), __ATOMIC_RELAXED);
+	__atomic_store_n(&clock->fragment, samples, __ATOMIC_RELAXED);
+	__atomic_store_n(&clock->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static int64_t GetMixedFrames(struct MixerClock* clock, int64_t* time, unsigned int* fragment) {
+	unsigned int seq;
+	int64_t frames;
+	do {
+		seq = __atomic_load_n(&clock->seq, __ATOMIC_ACQUIRE);
+		frames = __atomic_load_n(&clock->frames, __ATOMIC_RELAXED);
+		*time = __atomic_load_n(&clock->time, __ATOMIC_RELAXED);
+		*fragment = __atomic_load_n(&clock->fragment, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || seq != __atomic_load_n(&clock->seq, __ATOMIC_RELAXED));
+	return frames;
+}
+
+void SetupAudioClocks(struct Game* game) {
+	ALLEGRO_MIXER* mixers[AUDIO_CLOCK_MIXERS] = {game->audio.music, game->audio.fx};
+	for (int i = 0; i < AUDIO_CLOCK_MIXERS; i++) {
+		struct MixerClock* clock = &game->data->clocks.mixers[i];
+		clock->mixer = mixers[i];
+		clock->frequency = al_get_mixer_frequency(mixers[i]);
+		al_set_mixer_postprocess_callback(mixers[i], MixerClockCallback, clock);
+	}
+}
+
+void DestroyAudioClocks(struct Game* game) {
+	// takes the mixer lock, so a callback that's already running gets to finish first
+	for (int i = 0; i < AUDIO_CLOCK_MIXERS; i++) {
+		al_set_mixer_postprocess_callback(game->data->clocks.mixers[i].mixer, NULL, NULL);
+	}
+}
+
+struct AudioClock* CreateAudioClock(struct Game* game, ALLEGRO_AUDIO_STREAM* stream, ALLEGRO_MIXER* mixer) {
+	// Clocks get walked through on every logic frame, so create them on the main thread
+	// (Gamestate_PostLoad is a good place), after the stream got its playmode.
+	struct AudioClock* clock = calloc(1, sizeof(struct AudioClock));
+	clock->stream = stream;
+	for (int i = 0; i < AUDIO_CLOCK_MIXERS; i++) {
+		if (game->data->clocks.mixers[i].mixer == mixer) {
+			clock->mixer = &game->data->clocks.mixers[i];
+		}
+	}
+	clock->length = al_get_audio_stream_length_secs(stream);
+	clock->loop = al_get_audio_stream_playmode(stream) == ALLEGRO_PLAYMODE_LOOP;
+	clock->next = game->data->clocks.list;
+	game->data->clocks.list = clock;
+	return clock;
+}
+
+// Returns the position without wrapping it around the length, in seconds.
+static double GetClockTime(struct Game* game, struct AudioClock* clock) {
+	if (!clock->mixer) {
+		return al_get_audio_stream_position_secs(clock->stream);
+	}
+	if (!clock->playing) {
+		return clock->offset;
+	}
+	int64_t time;
+	unsigned int fragment;
+	int64_t frames = GetMixedFrames(clock->mixer, &time, &fragment);
+	// in between callbacks, go on with the wall clock, but never past the fragment being mixed
+	double ahead = fmin((al_get_time() - time / 1000000.0) * clock->mixer->frequency, fragment);
+	return clock->offset + fmax(frames - clock->start + ahead, 0.0) / clock->mixer->frequency;
+}
+
+void PlayAudioClock(struct Game* game, struct AudioClock* clock, bool playing) {
+	if (playing == clock->playing) {
+		return;
+	}
+	if (!playing) {
+		clock->offset = GetClockTime(game, clock);
+	}
+	al_set_audio_stream_playing(clock->stream, playing);
+	if (playing && clock->mixer) {
+		// The stream gets mixed from the first fragment after this call on. Should one get mixed
+		// while the call waits for the mixer lock, the clock ends up that fragment late at most.
+		int64_t time;
+		unsigned int fragment;
+		clock->start = GetMixedFrames(clock->mixer, &time, &fragment);
+		clock->anchored = al_get_time();
+	}
+	clock->playing = playing;
+}
+
+void RewindAudioClock(struct Game* game, struct AudioClock* clock) {
+	al_rewind_audio_stream(clock->stream);
+	clock->offset = 0;
+	clock->lap = 0;
+	if (clock->playing && clock->mixer) {
+		int64_t time;
+		unsigned int fragment;
+		clock->start = GetMixedFrames(clock->mixer, &time, &fragment);
+		clock->anchored = al_get_time(); // give the stream a moment to get its buffers filled again
+	}
+	for (struct AudioCue* cue = clock->cues; cue; cue = cue->next) {
+		cue->fired = false;
+	}
+}
+
+double GetAudioClockPosition(struct Game* game, struct AudioClock* clock) {
+	double position = GetClockTime(game, clock);
+	if (clock->length <= 0) {
+		return position;
+	}
+	if (clock->loop) {
+		return fmod(position, clock->length);
+	}
+	return fmin(position, clock->length);
+}
+
+double GetAudioClockProgress(struct Game* game, struct AudioClock* clock) {
+	if (clock->length <= 0) {
+		return 1.0; // nothing to wait for
+	}
+	return GetAudioClockPosition(game, clock) / clock->length;
+}
+
+void AddAudioCue(struct Game* game, struct AudioClock* clock, double progress, void (*callback)(struct Game*, void*), void* data) {
+	struct AudioCue* cue = calloc(1, sizeof(struct AudioCue));
+	cue->progress = progress;
+	cue->callback = callback;
+	cue->data = data;
+	cue->next = clock->cues;
+	clock->cues = cue;
+}
+
+// Mixed frames only count time while the stream is actually being fed, so after an underrun the
+// clock would run ahead for good. Once a second it gets pulled back within what the stream itself
+// reports; that's where its decoder is, so up to the queued fragments ahead of what's been mixed.
+static void AnchorAudioClock(struct Game* game, struct AudioClock* clock) {
+	if (!clock->mixer || clock->length <= 0 || al_get_time() - clock->anchored < 1.0) {
+		return;
+	}
+	clock->anchored = al_get_time();
+	double stream = al_get_audio_stream_position_secs(clock->stream);
+	double queued = al_get_audio_stream_fragments(clock->stream) * al_get_audio_stream_length(clock->stream) / (double)al_get_audio_stream_frequency(clock->stream);
+	double position = GetClockTime(game, clock);
+	double drift = stream - (clock->loop ? fmod(position, clock->length) : position);
+	if (clock->loop) {
+		// the stream has wrapped around already, or the clock has
+		if (drift > clock->length / 2) {
+			drift -= clock->length;
+		} else if (drift < -clock->length / 2) {
+			drift += clock->length;
+		}
+	}
+	if (drift < 0) {
+		clock->offset += drift;
+	} else if (drift > queued) {
+		clock->offset += drift - queued;
+	}
+}
+
+void DispatchAudioCues(struct Game* game) {
+	// Cues run on the game thread, where they're free to switch scenes. At most one fires per frame,
+	// as it may well stop or destroy the clock it belongs to.
+	for (struct AudioClock* clock = game->data->clocks.list; clock; clock = clock->next) {
+		if (!clock->playing) {
+			continue;
+		}
+		AnchorAudioClock(game, clock);
+		if (!clock->cues) {
+			continue;
+		}
+		if (clock->loop && clock->length > 0) {
+			int lap = GetClockTime(game, clock) / clock->length;
+			if (lap > clock->lap) { // anchoring may pull the clock back across a lap, which doesn't count
+				clock->lap = lap;
+				for (struct AudioCue* cue = clock->cues; cue; cue = cue->next) {
+					cue->fired = false;
+				}
+			}
+		}
+		// whatever the clock says, a stream that plays once has only ended when the mixer is done with it
+		bool ended = clock->loop || !al_get_audio_stream_playing(clock->stream);
+		double progress = (clock->loop || !ended) ? GetAudioClockProgress(game, clock) : 1.0;
+		for (struct AudioCue* cue = clock->cues; cue; cue = cue->next) {
+			if (!cue->fired && progress >= cue->progress && (cue->progress < 1.0 || ended)) {
+				cue->fired = true;
+				cue->callback(game, cue->data);
+				return;
+			}
+		}
+	}
+}
+
+void DestroyAudioClock(struct Game* game, struct AudioClock* clock) {
+	struct AudioClock** tmp = &game->data->clocks.list;
+	while (*tmp != clock) {
+		tmp = &(*tmp)->next;
+	}
+	*tmp = clock->next;
+	while (clock->cues) {
+		struct AudioCue* cue = clock->cues;
+		clock->cues = cue->next;
+		free(cue);
+	}
+	free(clock);
+}
@@ -20,23 +20,2164 @@
 
 #include "common.h"
 #include <libsuperderpy.h>
+#include <time.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Order in which the scenes are visited, along with their estimated texture footprint (in MB)
+// and the data files they load (spritesheet .ini files drag their frames along). The files are
+// only used until the scene has been played once, see RecordSceneAsset.
+static struct {
+	char* name;
+	char* next;
+	int size;
+	char* assets[12];
+} scenes[] = {
+	{"intro", "logo", 26, {"sprites/grzebien/grzebien_rosnie.ini", "sprites/grzebien/grzebien_rosnie_skrzydelka.ini", "sprites/grzebien/grzebien_macha.ini",
+													"grzebien.flac", "grzebienrosnie.flac", "grzebienodlot.flac", "1.flac", "2.flac", "3.flac"}},
+	{"logo", "gaski", 25, {"chodnik.webp", "gradient.webp", "logo.webp", "byholypangolin.webp", "logo.flac"}},
+	{"gaski", "but", 320, {"sprites/gaski/przod1.ini", "sprites/gaski/przod2.ini", "sprites/gaski/tyl1.ini", "sprites/gaski/tyl2.ini",
+													"sprites/bgs/bgs.ini", "niepokoj.flac", "gaska.flac"}},
+	{"but", "bongo", 127, {"sprites/but/but.ini", "sprites/but/standby.ini", "sprites/but/blank.ini", "sprites/but/mask.webp", "bongobg.flac", "but.flac"}},
+	{"bongo", "taniec", 8, {"bongo.webp", "bongomask.webp", "bongo1.flac", "bongo2.flac", "bongo3.flac", "bongo4.flac", "bongo5.flac", "bongobg.flac"}},
+	{"taniec", "domek", 141, {"bongo.webp", "gradient.webp", "bongobg.flac", "taniec.flac", "sprites/niebieski/niebieski_przod.ini", "sprites/niebieski/niebieski_tyl.ini",
+														"sprites/sowka/sowka_przod.ini", "sprites/sowka/sowka_tyl.ini", "sprites/grzebien/grzebien_macha.ini"}},
+	{"domek", "rave", 8, {"domek.flac", "domek.jpg", "domekmask.webp", "domek.ogv"}},
+	{"rave", "pudelko", 71, {"rave.flac", "silence.flac", "sprites/rave/niebieski_z_tlem.ini", "sprites/rave/mask.webp"}},
+	{"pudelko", "pienki", 229, {"bongobg.flac", "pudelko1.flac", "pudelko2.flac", "pudelko3.flac", "sprites/pudelko/pudelko.ini", "sprites/pudelko/pudelko1.ini",
+															 "sprites/pudelko/pudelko2.ini", "sprites/pudelko/pudelko3.ini", "sprites/pudelko/mask.webp"}},
+	{"pienki", "altanka", 87, {"pienki.flac", "pac.flac", "sprites/pienki/pienki_myszka.ini", "sprites/pienki/mask.ini"}},
+	{"altanka", "ciuchcia", 142, {"myszki.flac", "sprites/altanka/altanka.ini"}},
+	{"ciuchcia", "wrona", 27, {"ciuchcia.flac", "most.webp", "but_nieanimowany.webp", "gradient.webp"}},
+	{"wrona", "rzeczka", 24, {"wrona.flac", "alarm.flac", "wrona.ogv"}},
+	{"rzeczka", NULL, 105, {"myszki/prawo2.webp", "fonts/DejaVuSansMono.ttf", "rzeczka.flac", "odlot.flac", "sprites/rzeczka/animacja_rzeka.ini", "sprites/rzeczka/mask.webp"}},
+};
+
+#define SCENE_COUNT (int)(sizeof(scenes) / sizeof(scenes[0]))
+
+static int FindScene(const char* name) {
+	if (!name) {
+		return -1;
+	}
+	for (int i = 0; i < SCENE_COUNT; i++) {
+		if (strcmp(scenes[i].name, name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static bool HasFile(char* const* files, int count, const char* filename) {
+	for (int i = 0; i < count; i++) {
+		if (strcmp(files[i], filename) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static int CountListedAssets(int scene) {
+	int count = 0;
+	while (count < 12 && scenes[scene].assets[count]) {
+		count++;
+	}
+	return count;
+}
+
+static struct Gamestate* GetScene(struct Game* game, const char* name) {
+	struct Gamestate* tmp = game->_priv.gamestates;
+	while (tmp) {
+		if (strcmp(tmp->name, name) == 0) {
+			return tmp;
+		}
+		tmp = tmp->next;
+	}
+	return NULL;
+}
+
+static struct Gamestate* GetCurrentGamestate(struct Game* game) {
+	struct Gamestate* tmp = game->_priv.gamestates;
+	while (tmp) {
+		if (tmp->loaded && tmp->started) {
+			return tmp;
+		}
+		tmp = tmp->next;
+	}
+	return NULL;
+}
+
+static bool IsResident(struct Game* game, const char* name) {
+	struct Gamestate* gs = GetScene(game, name);
+	return gs && (gs->loaded || gs->pending_load) && !gs->pending_unload;
+}
+
+// Has to be called with manifest.mutex locked.
+static struct SceneAssets* FindSceneAssets(struct Game* game, const char* name) {
+	struct SceneAssets* assets = game->data->manifest.list;
+	while (assets && strcmp(assets->name, name) != 0) {
+		assets = assets->next;
+	}
+	return assets;
+}
+
+static struct SceneAssets* AddSceneAssets(struct Game* game, const char* name) {
+	struct SceneAssets* assets = calloc(1, sizeof(struct SceneAssets));
+	assets->name = strdup(name);
+	assets->next = game->data->manifest.list;
+	game->data->manifest.list = assets;
+	return assets;
+}
+
+static void AddSceneAsset(struct SceneAssets* assets, const char* filename) {
+	if (HasFile(assets->files, assets->count, filename)) {
+		return;
+	}
+	assets->files = realloc(assets->files, sizeof(char*) * (assets->count + 1));
+	assets->files[assets->count++] = strdup(filename);
+}
+
+static void ClearSceneAssets(struct SceneAssets* assets) {
+	for (int i = 0; i < assets->count; i++) {
+		free(assets->files[i]);
+	}
+	free(assets->files);
+	assets->files = NULL;
+	assets->count = 0;
+}
+
+// Called for every data file acquired through the functions below, so prefetching and the audio
+// policy go by what scenes actually load rather than by a list that has to be kept up by hand.
+static void RecordSceneAsset(struct Game* game, const char* filename) {
+	// while loading, the engine knows whose Gamestate_Load (or PostLoad) is running;
+	// anything acquired afterwards belongs to the gamestate being played
+	struct Gamestate* gamestate = game->_priv.loading.current;
+	if (!gamestate) {
+		gamestate = GetCurrentGamestate(game);
+	}
+	if (!gamestate) {
+		return;
+	}
+	al_lock_mutex(game->data->manifest.mutex);
+	struct SceneAssets* assets = FindSceneAssets(game, gamestate->name);
+	if (!assets) {
+		assets = AddSceneAssets(game, gamestate->name);
+	}
+	if (!assets->recorded) {
+		// whatever was read back from the last run gets replaced
+		ClearSceneAssets(assets);
+		assets->recorded = true;
+	}
+	AddSceneAsset(assets, filename);
+	al_unlock_mutex(game->data->manifest.mutex);
+}
+
+static ALLEGRO_PATH* GetManifestPath(void) {
+	ALLEGRO_PATH* path = al_get_standard_path(ALLEGRO_USER_DATA_PATH);
+	al_set_path_filename(path, "scenes.ini");
+	return path;
+}
+
+static void LoadSceneManifest(struct Game* game) {
+	ALLEGRO_PATH* path = GetManifestPath();
+	ALLEGRO_CONFIG* config = al_load_config_file(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+	al_destroy_path(path);
+	if (!config) {
+		return; // first run, so the lists in scenes[] have to do
+	}
+	ALLEGRO_CONFIG_SECTION* iterator;
+	for (const char* section = al_get_first_config_section(config, &iterator); section; section = al_get_next_config_section(&iterator)) {
+		const char* files = al_get_config_value(config, section, "files");
+		if (!*section || !files) {
+			continue;
+		}
+		struct SceneAssets* assets = AddSceneAssets(game, section);
+		int count = strtol(files, NULL, 10);
+		for (int i = 0; i < count; i++) {
+			char key[16];
+			snprintf(key, sizeof(key), "file%d", i);
+			const char* file = al_get_config_value(config, section, key);
+			if (file) {
+				AddSceneAsset(assets, file);
+			}
+		}
+	}
+	al_destroy_config(config);
+}
+
+static void SaveSceneManifest(struct Game* game) {
+	bool recorded = false;
+	ALLEGRO_CONFIG* config = al_create_config();
+	for (struct SceneAssets* assets = game->data->manifest.list; assets; assets = assets->next) {
+		char value[16];
+		snprintf(value, sizeof(value), "%d", assets->count);
+		al_set_config_value(config, assets->name, "files", value);
+		for (int i = 0; i < assets->count; i++) {
+			char key[16];
+			snprintf(key, sizeof(key), "file%d", i);
+			al_set_config_value(config, assets->name, key, assets->files[i]);
+		}
+		recorded |= assets->recorded;
+	}
+	if (recorded) {
+		ALLEGRO_PATH* path = GetManifestPath();
+		const char* filename = al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP);
+		ALLEGRO_PATH* dir = al_clone_path(path);
+		al_set_path_filename(dir, NULL);
+		al_make_directory(al_path_cstr(dir, ALLEGRO_NATIVE_PATH_SEP));
+		al_destroy_path(dir);
+		if (!al_save_config_file(filename, config)) {
+			PrintConsole(game, "Could not write %s!", filename);
+		}
+		al_destroy_path(path);
+	}
+	al_destroy_config(config);
+
+	while (game->data->manifest.list) {
+		struct SceneAssets* assets = game->data->manifest.list;
+		game->data->manifest.list = assets->next;
+		ClearSceneAssets(assets);
+		free(assets->name);
+		free(assets);
+	}
+}
+
+// Returns the number of gamestates that load given data file.
+static int CountSceneUses(struct Game* game, const char* filename) {
+	int uses = 0;
+	al_lock_mutex(game->data->manifest.mutex);
+	for (struct SceneAssets* assets = game->data->manifest.list; assets; assets = assets->next) {
+		uses += HasFile(assets->files, assets->count, filename);
+	}
+	for (int i = 0; i < SCENE_COUNT; i++) {
+		if (!FindSceneAssets(game, scenes[i].name)) {
+			uses += HasFile(scenes[i].assets, CountListedAssets(i), filename);
+		}
+	}
+	al_unlock_mutex(game->data->manifest.mutex);
+	return uses;
+}
+
+// Scenes whose recorded files differ from their list in scenes[] would get the wrong files
+// prefetched on a first run. Returns the differences found in this run; the caller frees them.
+static int CheckSceneAssets(struct Game* game, char*** problems) {
+	int count = 0;
+	*problems = NULL;
+	al_lock_mutex(game->data->manifest.mutex);
+	for (int i = 0; i < SCENE_COUNT; i++) {
+		struct SceneAssets* assets = FindSceneAssets(game, scenes[i].name);
+		if (!assets || !assets->recorded) {
+			continue; // not played
+		}
+		int listed = CountListedAssets(i);
+		for (int j = 0; j < assets->count + listed; j++) {
+			bool loaded = j < assets->count;
+			const char* file = loaded ? assets->files[j] : scenes[i].assets[j - assets->count];
+			if (loaded ? HasFile(scenes[i].assets, listed, file) : HasFile(assets->files, assets->count, file)) {
+				continue;
+			}
+			char problem[255];
+			snprintf(problem, sizeof(problem), "%s %s %s", scenes[i].name, loaded ? "loads unlisted" : "lists unused", file);
+			*problems = realloc(*problems, sizeof(char*) * (count + 1));
+			(*problems)[count++] = strdup(problem);
+		}
+	}
+	al_unlock_mutex(game->data->manifest.mutex);
+	return count;
+}
+
+// Marks which scenes should be resident while <current> is running and returns their estimated size.
+static int GetResidencyWindow(struct Game* game, int current, bool keep[SCENE_COUNT]) {
+	// keep the upcoming scene and as many of the following ones as lookahead and budget allow;
+	// the next one is always kept, otherwise we would end up loading in the middle of a transition
+	int used = 0;
+	int i = current;
+	for (int n = 0; i >= 0 && n <= game->data->residency.lookahead; n++) {
+		if (n > 1 && used + scenes[i].size > game->data->residency.budget) {
+			break;
+		}
+		keep[i] = true;
+		used += scenes[i].size;
+		i = FindScene(scenes[i].next);
+	}
+	return used;
+}
+
+static void PrefetchFile(ALLEGRO_THREAD* thread, const char* path, char* buffer, size_t size) {
+	ALLEGRO_FILE* file = al_fopen(path, "rb");
+	if (!file) {
+		return;
+	}
+	while (!al_get_thread_should_stop(thread) && al_fread(file, buffer, size) == size) {}
+	al_fclose(file);
+}
+
+static void* PrefetchThread(ALLEGRO_THREAD* thread, void* arg) {
+	struct Prefetch* prefetch = arg;
+	char* buffer = malloc(64 * 1024);
+	UseAssetPack(prefetch->game); // reading packed files faults their pages in
+
+	for (int i = 0; i < prefetch->count; i++) {
+		if (al_get_thread_should_stop(thread)) {
+			break;
+		}
+		PrefetchFile(thread, prefetch->files[i], buffer, 64 * 1024);
+
+		size_t len = strlen(prefetch->files[i]);
+		if (len > 4 && strcmp(prefetch->files[i] + len - 4, ".ini") == 0) {
+			// spritesheet - read its atlas or frames as well
+			ALLEGRO_CONFIG* config = al_load_config_file(prefetch->files[i]);
+			if (config) {
+				const char* count = al_get_config_value(config, "animation", "frames");
+				int frames = count ? strtol(count, NULL, 10) : 0;
+				ALLEGRO_PATH* path = al_create_path(prefetch->files[i]);
+				for (int j = -1; j < frames && !al_get_thread_should_stop(thread); j++) {
+					char section[16] = "animation";
+					if (j >= 0) {
+						snprintf(section, sizeof(section), "frame%d", j);
+					}
+					const char* file = al_get_config_value(config, section, "file");
+					if (file) {
+						al_set_path_filename(path, file);
+						PrefetchFile(thread, al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP), buffer, 64 * 1024);
+					}
+				}
+				al_destroy_path(path);
+				al_destroy_config(config);
+			}
+		}
+
+		al_lock_mutex(prefetch->mutex);
+		prefetch->done++;
+		al_unlock_mutex(prefetch->mutex);
+	}
+
+	free(buffer);
+	return NULL;
+}
+
+static void StopPrefetch(struct Game* game) {
+	struct Prefetch* prefetch = &game->data->prefetch;
+	if (prefetch->thread) {
+		al_set_thread_should_stop(prefetch->thread);
+		al_join_thread(prefetch->thread, NULL);
+		al_destroy_thread(prefetch->thread);
+		prefetch->thread = NULL;
+	}
+	for (int i = 0; i < prefetch->count; i++) {
+		free(prefetch->files[i]);
+	}
+	free(prefetch->files);
+	prefetch->files = NULL;
+	prefetch->count = 0;
+	prefetch->done = 0;
+	free(prefetch->target);
+	prefetch->target = NULL;
+}
+
+// Reads the files of all scenes that are going to be loaded once <name> gets entered,
+// so loading them later on isn't bound by I/O.
+static void StartPrefetch(struct Game* game, char* name) {
+	struct Prefetch* prefetch = &game->data->prefetch;
+	int current = FindScene(name);
+	if (current < 0 || (prefetch->target && strcmp(prefetch->target, name) == 0)) {
+		return;
+	}
+	StopPrefetch(game);
+
+	bool keep[SCENE_COUNT] = {0};
+	GetResidencyWindow(game, current, keep);
+
+	for (int i = 0; i < SCENE_COUNT; i++) {
+		if (!keep[i] || IsResident(game, scenes[i].name)) {
+			continue;
+		}
+		al_lock_mutex(game->data->manifest.mutex);
+		struct SceneAssets* assets = FindSceneAssets(game, scenes[i].name);
+		int count = assets ? assets->count : CountListedAssets(i);
+		for (int j = 0; j < count; j++) {
+			// GetDataFilePath isn't safe to call from other threads, so resolve the paths here
+			prefetch->files = realloc(prefetch->files, sizeof(char*) * (prefetch->count + 1));
+			prefetch->files[prefetch->count++] = strdup(GetDataFilePath(game, assets ? assets->files[j] : scenes[i].assets[j]));
+		}
+		al_unlock_mutex(game->data->manifest.mutex);
+	}
+	prefetch->target = strdup(name);
+
+	if (prefetch->count) {
+		prefetch->game = game;
+		prefetch->thread = al_create_thread(PrefetchThread, prefetch);
+		al_start_thread(prefetch->thread);
+	}
+}
+
+double GetPrefetchProgress(struct Game* game) {
+	struct Prefetch* prefetch = &game->data->prefetch;
+	if (!prefetch->count) {
+		return 1.0;
+	}
+	al_lock_mutex(prefetch->mutex);
+	double progress = prefetch->done / (double)prefetch->count;
+	al_unlock_mutex(prefetch->mutex);
+	return progress;
+}
+
+void UpdateResidency(struct Game* game, char* name) {
+	int current = FindScene(name);
+	if (current < 0) {
+		LoadGamestate(game, name);
+		return;
+	}
+
+	bool keep[SCENE_COUNT] = {0};
+	int used = GetResidencyWindow(game, current, keep);
+
+	for (int i = 0; i < SCENE_COUNT; i++) {
+		bool resident = IsResident(game, scenes[i].name);
+		if (keep[i] && !resident) {
+			LoadGamestate(game, scenes[i].name);
+		} else if (!keep[i] && resident && !GetScene(game, scenes[i].name)->started) {
+			UnloadGamestate(game, scenes[i].name);
+		}
+	}
+
+	PrintConsole(game, "Residency for \"%s\": ~%d MB of %d MB budget", name, used, game->data->residency.budget);
+
+	// warm up whatever will be needed once we move on from here
+	if (scenes[current].next) {
+		StartPrefetch(game, scenes[current].next);
+	}
+}
+
+void SwitchScene(struct Game* game, char* name) {
+	if (game->data->next) {
+		free(game->data->next);
+	}
+	game->data->next = strdup(name);
+	if (!IsResident(game, name)) {
+		LoadGamestate(game, name);
+	}
+	// the rest of the residency window gets loaded once the transition ends; until then
+	// its files are prefetched in the background and myszka waits for them if needed
+	StartPrefetch(game, name);
+	SwitchCurrentGamestate(game, "myszka");
+}
+
+void EnterScene(struct Game* game, char* name) {
+	game->data->benchmark.requested = al_get_time();
+	UpdateResidency(game, name);
+	SwitchCurrentGamestate(game, name);
+}
+
+#define BENCHMARK_TIMEOUT 180.0 // seconds spent in a single scene before giving up
+#define BENCHMARK_CLICK_INTERVAL 0.5
+
+#define NOISE_SIZE 256
+
+// Gaussian-distributed noise matching what grain.glsl computes per pixel, normalized by its peak.
+static ALLEGRO_BITMAP* CreateNoiseBitmap(void) {
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+	// no filtering, so wrapping around with fract() in the shader stays seamless
+	al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+	ALLEGRO_BITMAP* bitmap = al_create_bitmap(NOISE_SIZE, NOISE_SIZE);
+	al_restore_state(&state);
+
+	ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+	uint32_t seed = 2463534242u; // own xorshift, so rand() sequences stay untouched
+	for (int y = 0; y < NOISE_SIZE; y++) {
+		unsigned char* row = (unsigned char*)region->data + y * region->pitch;
+		for (int x = 0; x < NOISE_SIZE; x++) {
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			double u = seed / 4294967296.0;
+			// gaussian(u, 0.5, 0.25) divided by its peak
+			unsigned char value = (unsigned char)(exp(-((u - 0.5) * (u - 0.5)) / (2.0 * 0.25 * 0.25)) * 255.0 + 0.5);
+			row[x * 4 + 0] = row[x * 4 + 1] = row[x * 4 + 2] = value;
+			row[x * 4 + 3] = 255;
+		}
+	}
+	al_unlock_bitmap(bitmap);
+	return bitmap;
+}
+
+static ALLEGRO_SHADER* CreateGrainShader(struct Game* game, bool texture) {
+	if (texture) {
+		return CreateShader(game, GetDataFilePath(game, "shaders/vertex_noise.glsl"), GetDataFilePath(game, "shaders/grain_texture.glsl"));
+	}
+	return CreateShader(game, GetDataFilePath(game, "shaders/vertex.glsl"), GetDataFilePath(game, "shaders/grain.glsl"));
+}
+
+// Has to be called with the grain shader in use, before drawing given bitmap with it.
+static void SetGrainUniforms(struct Game* game, ALLEGRO_BITMAP* noise, ALLEGRO_BITMAP* bitmap) {
+	al_set_shader_float("time", game->time);
+	if (noise) {
+		float scale[2] = {al_get_bitmap_width(bitmap) / (float)NOISE_SIZE, al_get_bitmap_height(bitmap) / (float)NOISE_SIZE};
+		al_set_shader_sampler("noise_tex", noise, 1);
+		al_set_shader_float_vector("noise_scale", 2, scale, 1);
+	}
+}
+
+// Returns the average time of a full-screen grain pass in milliseconds.
+static double MeasureGrain(struct Game* game, bool texture) {
+	ALLEGRO_SHADER* shader = CreateGrainShader(game, texture);
+	ALLEGRO_BITMAP* noise = texture ? CreateNoiseBitmap() : NULL;
+	ALLEGRO_BITMAP* source = al_create_bitmap(game->viewport.width, game->viewport.height);
+	ALLEGRO_BITMAP* target = al_create_bitmap(game->viewport.width, game->viewport.height);
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP);
+
+	al_set_target_bitmap(source);
+	al_clear_to_color(al_map_rgb(128, 128, 128));
+	al_set_target_bitmap(target);
+	al_use_shader(shader);
+
+	double start = 0;
+	int passes = 120;
+	for (int i = -10; i < passes; i++) {
+		if (i == 0) {
+			// reading a pixel back waits for the GPU to finish everything queued so far
+			al_lock_bitmap_region(target, 0, 0, 1, 1, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
+			al_unlock_bitmap(target);
+			start = al_get_time();
+		}
+		SetGrainUniforms(game, noise, source);
+		al_draw_bitmap(source, 0, 0, 0);
+	}
+	al_lock_bitmap_region(target, 0, 0, 1, 1, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
+	al_unlock_bitmap(target);
+	double time = (al_get_time() - start) / passes * 1000.0;
+
+	al_use_shader(NULL);
+	al_restore_state(&state);
+	al_destroy_bitmap(source);
+	al_destroy_bitmap(target);
+	if (noise) {
+		al_destroy_bitmap(noise);
+	}
+	DestroyShader(game, shader);
+	return time;
+}
+
+void StartBenchmark(struct Game* game, char* output) {
+	game->data->benchmark.enabled = true;
+	game->data->benchmark.output = strdup(output);
+	game->data->benchmark.requested = al_get_time();
+	PrintConsole(game, "Benchmark mode, results will be written to %s", output);
+
+	game->data->benchmark.grain[0] = MeasureGrain(game, false);
+	game->data->benchmark.grain[1] = MeasureGrain(game, true);
+	PrintConsole(game, "Benchmark: grain pass takes %.2f ms procedural, %.2f ms with noise texture", game->data->benchmark.grain[0], game->data->benchmark.grain[1]);
+}
+
+void BenchmarkTarget(struct Game* game, double x, double y) {
+	game->data->benchmark.x = x;
+	game->data->benchmark.y = y;
+	game->data->benchmark.target = true;
+}
+
+static double GetPeakMemory(void) {
+	// in MB
+#if defined(__APPLE__)
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0 / 1024.0;
+#elif defined(__unix__)
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0;
+#else
+	return 0;
+#endif
+}
+
+static void BenchmarkFrame(struct Game* game) {
+	double now = al_get_time();
+	struct BenchmarkScene* scene = game->data->benchmark.current;
+	if (scene && game->data->benchmark.last && !game->_priv.loading.shown) {
+		if (scene->count == scene->size) {
+			scene->size = scene->size ? scene->size * 2 : 1024;
+			scene->frames = realloc(scene->frames, scene->size * sizeof(double));
+		}
+		scene->frames[scene->count++] = now - game->data->benchmark.last;
+	}
+	game->data->benchmark.last = now;
+}
+
+static void BenchmarkClick(struct Game* game) {
+	ALLEGRO_EVENT ev = {0};
+	ev.mouse.type = ALLEGRO_EVENT_MOUSE_BUTTON_DOWN;
+	ev.mouse.x = game->data->mouseX * game->_priv.clip_rect.w + game->_priv.clip_rect.x;
+	ev.mouse.y = game->data->mouseY * game->_priv.clip_rect.h + game->_priv.clip_rect.y;
+	ev.mouse.button = 1;
+	al_emit_user_event(&game->event_source, &ev, NULL);
+	game->data->benchmark.cooldown = BENCHMARK_CLICK_INTERVAL;
+}
+
+static void UpdateBenchmark(struct Game* game, double delta) {
+	struct Gamestate* gamestate = GetCurrentGamestate(game);
+	if (!gamestate) {
+		return;
+	}
+
+	struct BenchmarkScene* scene = game->data->benchmark.current;
+	if (!scene || strcmp(scene->name, gamestate->name) != 0) {
+		if (scene) {
+			scene->peak = GetPeakMemory();
+		}
+		scene = calloc(1, sizeof(struct BenchmarkScene));
+		scene->name = strdup(gamestate->name);
+		// myszka plays while the next scene is being loaded, so its time is the load time of what comes after it
+		scene->load = strcmp(gamestate->name, "myszka") ? al_get_time() - game->data->benchmark.requested : 0;
+		struct BenchmarkScene** tmp = &game->data->benchmark.scenes;
+		while (*tmp) {
+			tmp = &(*tmp)->next;
+		}
+		*tmp = scene;
+		game->data->benchmark.current = scene;
+		game->data->benchmark.entered = al_get_time();
+		PrintConsole(game, "Benchmark: entered %s after %.1f ms", scene->name, scene->load * 1000.0);
+	}
+
+	if (al_get_time() - game->data->benchmark.entered > BENCHMARK_TIMEOUT) {
+		PrintConsole(game, "Benchmark: stuck in %s, giving up", scene->name);
+		game->data->benchmark.timeout = true;
+		UnloadAllGamestates(game);
+		return;
+	}
+
+	game->data->benchmark.cooldown -= delta;
+	if (game->data->benchmark.target) {
+		// The scene says where it wants to be clicked, so go straight there instead of relying on hover,
+		// which would keep the cursor on whatever it hit last. No sweeping while targets keep coming.
+		game->data->mouseX = game->data->benchmark.x;
+		game->data->mouseY = game->data->benchmark.y;
+		if (game->data->benchmark.cooldown <= 0) {
+			game->data->benchmark.target = false;
+			BenchmarkClick(game);
+		}
+		return;
+	}
+	if (game->data->hover && game->data->benchmark.cooldown <= 0) {
+		// the cursor stays where it is, so the scene sees it hovering again when the click arrives
+		BenchmarkClick(game);
+		return;
+	}
+	if (game->data->hover) {
+		return;
+	}
+
+	// sweep the screen with an R2 low-discrepancy sequence until something can be clicked
+	game->data->benchmark.step++;
+	game->data->mouseX = fmod(0.5 + game->data->benchmark.step * 0.7548776662466927, 1.0);
+	game->data->mouseY = fmod(0.5 + game->data->benchmark.step * 0.5698402909980532, 1.0);
+}
+
+static int CompareDoubles(const void* a, const void* b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+static double GetPercentile(double* sorted, int count, double percentile) {
+	if (!count) {
+		return 0;
+	}
+	int i = (int)(percentile / 100.0 * (count - 1) + 0.5);
+	return sorted[i] * 1000.0;
+}
+
+static double GetFragmentLength(struct Game* game) {
+	return game->data->percussion.fragment / (double)al_get_mixer_frequency(game->audio.fx);
+}
+
+static void WriteBenchmark(struct Game* game) {
+	struct BenchmarkScene* scene = game->data->benchmark.scenes;
+	bool completed = !game->data->benchmark.timeout && game->data->benchmark.current && strcmp(game->data->benchmark.current->name, "rzeczka") == 0;
+	// a run that found scenes[] out of date doesn't count, so it gets fixed before anything else
+	char** problems;
+	int mismatches = CheckSceneAssets(game, &problems);
+	for (int i = 0; i < mismatches; i++) {
+		PrintConsole(game, "Benchmark: scenes[] is out of date, %s!", problems[i]);
+	}
+	completed = completed && !mismatches;
+	if (game->data->benchmark.current) {
+		game->data->benchmark.current->peak = GetPeakMemory();
+	}
+
+	FILE* file = fopen(game->data->benchmark.output, "w");
+	if (!file) {
+		PrintConsole(game, "Could not write benchmark results to %s!", game->data->benchmark.output);
+	} else {
+		fprintf(file, "{\n\t\"completed\": %s,\n\t\"peak_memory_mb\": %.1f,\n\t\"asset_mismatches\": [", completed ? "true" : "false", GetPeakMemory());
+		for (int i = 0; i < mismatches; i++) {
+			fprintf(file, "%s\"%s\"", i ? ", " : "", problems[i]);
+		}
+		fprintf(file, "],\n");
+		fprintf(file, "\t\"grain_ms\": {\"mode\": \"%s\", \"procedural\": %.3f, \"texture\": %.3f},\n",
+			game->data->noise ? "texture" : "procedural", game->data->benchmark.grain[0], game->data->benchmark.grain[1]);
+		double* latencies = game->data->percussion.latencies;
+		int hits = game->data->percussion.count;
+		qsort(latencies, hits, sizeof(double), CompareDoubles);
+		fprintf(file, "\t\"audio_latency_ms\": {\"backend\": \"%s\", \"fragment\": %.2f, \"hits\": %d, \"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f},\n\t\"scenes\": [",
+			game->data->percussion.backend, GetFragmentLength(game) * 1000.0, hits, GetPercentile(latencies, hits, 50),
+			GetPercentile(latencies, hits, 99), GetPercentile(latencies, hits, 100));
+		while (scene) {
+			qsort(scene->frames, scene->count, sizeof(double), CompareDoubles);
+			fprintf(file, "\n\t\t{\"name\": \"%s\", \"load_ms\": %.2f, \"frames\": %d, \"frame_ms\": {\"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}, \"peak_memory_mb\": %.1f}%s",
+				scene->name, scene->load * 1000.0, scene->count, GetPercentile(scene->frames, scene->count, 50), GetPercentile(scene->frames, scene->count, 90),
+				GetPercentile(scene->frames, scene->count, 99), GetPercentile(scene->frames, scene->count, 100), scene->peak, scene->next ? "," : "");
+			scene = scene->next;
+		}
+		fprintf(file, "\n\t]\n}\n");
+		fclose(file);
+		PrintConsole(game, "Benchmark results written to %s", game->data->benchmark.output);
+	}
+
+	for (int i = 0; i < mismatches; i++) {
+		free(problems[i]);
+	}
+	free(problems);
+
+	while (game->data->benchmark.scenes) {
+		scene = game->data->benchmark.scenes;
+		game->data->benchmark.scenes = scene->next;
+		free(scene->name);
+		free(scene->frames);
+		free(scene);
+	}
+	free(game->data->benchmark.output);
+}
+
+int GetThreadId(void) {
+	static int threads = 0;
+	static _Thread_local int id = 0;
+	if (!id) {
+		id = __atomic_add_fetch(&threads, 1, __ATOMIC_RELAXED);
+	}
+	return id;
+}
+
+void ProfileSpan(struct Game* game, const char* category, const char* name, double start) {
+	double end = al_get_time();
+	al_lock_mutex(game->data->profile.mutex);
+	struct ProfileEvent* event = &game->data->profile.events[game->data->profile.count % PROFILE_EVENTS];
+	snprintf(event->name, sizeof(event->name), "%s", name);
+	event->category = category;
+	event->start = start;
+	event->duration = end - start;
+	event->thread = GetThreadId();
+	game->data->profile.count++;
+	al_unlock_mutex(game->data->profile.mutex);
+}
+
+static void ProfileStage(struct Game* game, int stage, const char* category, double start) {
+	struct Gamestate* gamestate = GetCurrentGamestate(game);
+	ProfileSpan(game, category, gamestate ? gamestate->name : category, start);
+	game->data->profile.current[stage] += al_get_time() - start;
+}
+
+void PostLogic(struct Game* game, double delta) {
+	ProfileStage(game, PROFILE_LOGIC, "logic", game->data->profile.start[PROFILE_LOGIC]);
+}
+
+static const double RESOLUTION_SCALES[] = {1.0, 0.85, 0.7, 0.6, 0.5};
+
+static void SetupDynamicResolution(struct Game* game) {
+	game->data->resolution.enabled = strtol(GetConfigOptionDefault(game, "odlot", "dynamic_resolution", "0"), NULL, 10);
+	double min = strtod(GetConfigOptionDefault(game, "odlot", "min_scale", "0.5"), NULL);
+	game->data->resolution.steps = 1;
+	while (game->data->resolution.steps < (int)(sizeof(RESOLUTION_SCALES) / sizeof(RESOLUTION_SCALES[0])) &&
+		RESOLUTION_SCALES[game->data->resolution.steps] >= min) {
+		game->data->resolution.steps++;
+	}
+	int rate = al_get_display_refresh_rate(game->display);
+	game->data->resolution.budget = 1.0 / (rate > 0 ? rate : 60);
+	game->data->resolution.backoff = 5.0;
+}
+
+static void UpdateDynamicResolution(struct Game* game, const double* frame) {
+	if (!game->data->resolution.enabled || !frame[0]) {
+		return;
+	}
+	game->data->resolution.sum += frame[0];
+	if (frame[0] > game->data->resolution.worst) {
+		game->data->resolution.worst = frame[0];
+	}
+	for (int i = 1; i <= PROFILE_STAGES; i++) {
+		game->data->resolution.work += frame[i];
+	}
+	game->data->resolution.frames++;
+	if (game->data->resolution.frames < 30) {
+		return;
+	}
+
+	double average = game->data->resolution.sum / game->data->resolution.frames;
+	double work = game->data->resolution.work / game->data->resolution.frames;
+	// hitches from loading aren't something a lower resolution could help with
+	bool hitch = game->data->resolution.worst > 0.1;
+	game->data->resolution.sum = 0;
+	game->data->resolution.work = 0;
+	game->data->resolution.worst = 0;
+	game->data->resolution.frames = 0;
+	if (hitch) {
+		return;
+	}
+
+	double now = al_get_time();
+	int step = game->data->resolution.step;
+	if (average > game->data->resolution.budget * 1.2) {
+		if (step < game->data->resolution.steps - 1) {
+			step++;
+		}
+		// dropping right after going up means that resolution is too much, so wait longer before retrying
+		if (now - game->data->resolution.raised < 2.0) {
+			game->data->resolution.backoff = fmin(game->data->resolution.backoff * 2, 60.0);
+		}
+		game->data->resolution.stable = 0;
+	} else if (step > 0) {
+		// with vsync the frame time sticks to the budget no matter how much time is left over,
+		// so going up is decided by the work actually done, scaled by the pixels it'd add
+		double ratio = RESOLUTION_SCALES[step - 1] / RESOLUTION_SCALES[step];
+		if (work * ratio * ratio < game->data->resolution.budget * 0.9) {
+			game->data->resolution.stable += average * 30;
+		} else {
+			game->data->resolution.stable = 0;
+		}
+		if (game->data->resolution.stable > game->data->resolution.backoff) {
+			step--;
+			game->data->resolution.raised = now;
+			game->data->resolution.stable = 0;
+		}
+	}
+	if (step != game->data->resolution.step) {
+		PrintConsole(game, "Resolution scale: %.0f%% (%.1f ms per frame)", RESOLUTION_SCALES[step] * 100, average * 1000.0);
+		game->data->resolution.step = step;
+	}
+}
+
+static int CountActiveScenes(struct Game* game) {
+	int active = 0;
+	struct Gamestate* gamestate = game->_priv.gamestates;
+	while (gamestate) {
+		if (gamestate->loaded && gamestate->started) {
+			active++;
+		}
+		gamestate = gamestate->next;
+	}
+	return active;
+}
+
+static void SwapScaledFramebuffers(struct Game* game) {
+	// The engine sets up the transformation from the size of the framebuffer it's drawing to, so
+	// gamestates keep drawing in viewport coordinates; Compositor scales the result to the clip rect.
+	// A scene running on its own doesn't get anything composited over it, so it's drawn at no more
+	// than the clip rect size right away, instead of at the full viewport size just to be scaled down.
+	if (game->_priv.loading.shown) {
+		return;
+	}
+	double scale = (game->data->resolution.enabled && game->data->resolution.step) ? RESOLUTION_SCALES[game->data->resolution.step] : 1.0;
+	bool single = CountActiveScenes(game) == 1;
+
+	struct Gamestate* gamestate = game->_priv.gamestates;
+	while (gamestate) {
+		int width = 0, height = 0;
+		if (gamestate->loaded && gamestate->started && gamestate->fb) {
+			width = al_get_bitmap_width(gamestate->fb);
+			height = al_get_bitmap_height(gamestate->fb);
+			if (single && game->_priv.clip_rect.w < width) {
+				width = game->_priv.clip_rect.w;
+				height = game->_priv.clip_rect.h;
+			}
+			width = ceil(width * scale);
+			height = ceil(height * scale);
+		}
+		if (width && (width != al_get_bitmap_width(gamestate->fb) || height != al_get_bitmap_height(gamestate->fb))) {
+			struct ScaledFramebuffer* scaled = game->data->resolution.framebuffers;
+			while (scaled && scaled->gamestate != gamestate) {
+				scaled = scaled->next;
+			}
+			if (!scaled) {
+				scaled = calloc(1, sizeof(struct ScaledFramebuffer));
+				scaled->gamestate = gamestate;
+				scaled->next = game->data->resolution.framebuffers;
+				game->data->resolution.framebuffers = scaled;
+			}
+			if (!scaled->fb || scaled->original != gamestate->fb || al_get_bitmap_width(scaled->fb) != width || al_get_bitmap_height(scaled->fb) != height) {
+				if (scaled->fb) {
+					al_destroy_bitmap(scaled->fb);
+				}
+				int flags = al_get_new_bitmap_flags();
+				al_set_new_bitmap_flags(flags | ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR);
+				scaled->fb = CreateNotPreservedBitmap(width, height);
+				al_set_new_bitmap_flags(flags);
+			}
+			scaled->original = gamestate->fb;
+			scaled->used = true;
+			gamestate->fb = scaled->fb;
+		}
+		gamestate = gamestate->next;
+	}
+}
+
+static void RestoreFramebuffers(struct Game* game) {
+	// the engine only ever gets to see its own framebuffers outside of drawing
+	struct ScaledFramebuffer** tmp = &game->data->resolution.framebuffers;
+	while (*tmp) {
+		struct ScaledFramebuffer* scaled = *tmp;
+		if (scaled->used) {
+			scaled->gamestate->fb = scaled->original;
+			scaled->used = false;
+			tmp = &scaled->next;
+		} else {
+			*tmp = scaled->next;
+			al_destroy_bitmap(scaled->fb);
+			free(scaled);
+		}
+	}
+}
+
+void PreDraw(struct Game* game) {
+	game->data->profile.start[PROFILE_DRAW] = al_get_time();
+	SwapScaledFramebuffers(game);
+}
+
+static void FinishProfileFrame(struct Game* game) {
+	double now = al_get_time();
+	double* frame = game->data->profile.frames[game->data->profile.frame % PROFILE_FRAMES];
+	frame[0] = game->data->profile.last ? now - game->data->profile.last : 0;
+	for (int i = 0; i < PROFILE_STAGES; i++) {
+		frame[i + 1] = game->data->profile.current[i];
+		game->data->profile.current[i] = 0;
+	}
+	game->data->profile.frame++;
+	game->data->profile.last = now;
+}
+
+static void DrawProfileOverlay(struct Game* game) {
+	// one bar per frame, logic/draw/compositor stacked in front of the whole frame time; 4 px per millisecond
+	static const ALLEGRO_COLOR colors[PROFILE_STAGES + 1] = {{0.3, 0.3, 0.3, 0.8}, {0.2, 0.4, 1.0, 1.0}, {0.2, 1.0, 0.4, 1.0}, {1.0, 0.3, 0.2, 1.0}};
+	float x = game->_priv.clip_rect.x + 10, y = game->_priv.clip_rect.y + 150;
+	double avg[PROFILE_STAGES + 1] = {0}, max = 0;
+	int frames = game->data->profile.frame < PROFILE_FRAMES ? game->data->profile.frame : PROFILE_FRAMES;
+
+	al_draw_filled_rectangle(x - 5, y - 145, x + PROFILE_FRAMES * 2 + 5, y + 25, al_map_rgba(0, 0, 0, 192));
+	for (int i = 0; i < frames; i++) {
+		double* frame = game->data->profile.frames[(game->data->profile.frame - frames + i) % PROFILE_FRAMES];
+		al_draw_filled_rectangle(x + i * 2, y - frame[0] * 4000.0, x + i * 2 + 2, y, colors[0]);
+		double bottom = y;
+		for (int j = 1; j <= PROFILE_STAGES; j++) {
+			al_draw_filled_rectangle(x + i * 2, bottom - frame[j] * 4000.0, x + i * 2 + 2, bottom, colors[j]);
+			bottom -= frame[j] * 4000.0;
+		}
+		for (int j = 0; j <= PROFILE_STAGES; j++) {
+			avg[j] += frame[j] / frames;
+		}
+		if (frame[0] > max) {
+			max = frame[0];
+		}
+	}
+	al_draw_line(x, y - 1000 / 60.0 * 4, x + PROFILE_FRAMES * 2, y - 1000 / 60.0 * 4, al_map_rgb(255, 255, 0), 1);
+	al_draw_line(x, y - 1000 / 30.0 * 4, x + PROFILE_FRAMES * 2, y - 1000 / 30.0 * 4, al_map_rgb(255, 0, 0), 1);
+
+	al_draw_textf(game->data->profile.font, al_map_rgb(255, 255, 255), x, y + 5, ALLEGRO_ALIGN_LEFT, "frame %.1f (max %.1f)", avg[0] * 1000.0, max * 1000.0);
+	al_draw_textf(game->data->profile.font, al_map_rgb(255, 255, 255), x, y + 15, ALLEGRO_ALIGN_LEFT, "logic %.1f draw %.1f comp %.1f ms", avg[1] * 1000.0, avg[2] * 1000.0, avg[3] * 1000.0);
+}
+
+static void WriteEscaped(FILE* file, const char* str) {
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\') {
+			fputc('\\', file);
+		}
+		fputc(*str, file);
+	}
+}
+
+void ExportTrace(struct Game* game) {
+	// Chrome trace event format, to be opened with chrome://tracing or Perfetto
+	ALLEGRO_PATH* path = al_get_standard_path(ALLEGRO_USER_DATA_PATH);
+	al_make_directory(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+	char filename[64];
+	snprintf(filename, sizeof(filename), "trace-%ld.json", (long)time(NULL));
+	al_set_path_filename(path, filename);
+
+	FILE* file = fopen(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP), "w");
+	if (!file) {
+		PrintConsole(game, "Could not write trace to %s!", al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+		al_destroy_path(path);
+		return;
+	}
+
+	al_lock_mutex(game->data->profile.mutex);
+	int first = game->data->profile.count > PROFILE_EVENTS ? game->data->profile.count - PROFILE_EVENTS : 0;
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+	for (int i = first; i < game->data->profile.count; i++) {
+		struct ProfileEvent* event = &game->data->profile.events[i % PROFILE_EVENTS];
+		fprintf(file, "%s\n{\"name\": \"", i == first ? "" : ",");
+		WriteEscaped(file, event->name);
+		fprintf(file, "\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.0f, \"dur\": %.0f, \"pid\": 1, \"tid\": %d}",
+			event->category, event->start * 1000000.0, event->duration * 1000000.0, event->thread);
+	}
+	fprintf(file, "\n]}\n");
+	al_unlock_mutex(game->data->profile.mutex);
+
+	fclose(file);
+	PrintConsole(game, "Trace with %d events written to %s", game->data->profile.count - first, al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+	al_destroy_path(path);
+}
+
+void PreLogic(struct Game* game, double delta) {
+	game->data->profile.start[PROFILE_LOGIC] = al_get_time();
+	if (game->data->benchmark.enabled) {
+		UpdateBenchmark(game, delta);
+	}
+	game->data->hover = false;
+	DispatchAudioCues(game);
+}
+
+// Returns the path to the variant of given file for given tier, or NULL if there's none. The caller frees it.
+static char* FindTieredFile(struct Game* game, const char* filename, int tier) {
+	if (tier == 1) {
+		return NULL;
+	}
+	char path[255];
+	snprintf(path, sizeof(path), "%s/%s", tier == 4 ? "quarter" : "half", filename);
+	return FindDataFilePath(game, path);
+}
+
+static int ClassifyPixel(const unsigned char* pixel, const unsigned char (*colors)[3], int count) {
+	if (!count) {
+		// anything that isn't fully red counts as a hit
+		return pixel[0] < 255;
+	}
+	// nearest hotspot color, with some slack for lossy compression
+	int best = 0, distance = HITMASK_TOLERANCE;
+	for (int i = 0; i < count; i++) {
+		int d = 0;
+		for (int c = 0; c < 3; c++) {
+			d += (pixel[c] - colors[i][c]) * (pixel[c] - colors[i][c]);
+		}
+		if (d < distance) {
+			distance = d;
+			best = i + 1;
+		}
+	}
+	return best;
+}
+
+struct HitMask* CreateHotspotMask(ALLEGRO_BITMAP* bitmap, const unsigned char (*colors)[3], int count) {
+	struct HitMask* mask = calloc(1, sizeof(struct HitMask));
+	mask->width = al_get_bitmap_width(bitmap);
+	mask->height = al_get_bitmap_height(bitmap);
+	mask->columns = (mask->width + HITMASK_CELL - 1) / HITMASK_CELL;
+	mask->rows = (mask->height + HITMASK_CELL - 1) / HITMASK_CELL;
+
+	unsigned char* ids = malloc(mask->width * mask->height);
+	ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+	for (int y = 0; y < mask->height; y++) {
+		unsigned char* row = (unsigned char*)region->data + y * region->pitch;
+		for (int x = 0; x < mask->width; x++) {
+			ids[y * mask->width + x] = ClassifyPixel(row + x * 4, colors, count);
+		}
+	}
+	al_unlock_bitmap(bitmap);
+
+	// Cells covered by a single hotspot (or none) are stored as just that; only the ones
+	// on region borders keep their pixels around.
+	mask->cells = calloc(mask->columns * mask->rows, sizeof(uint32_t));
+	int mixed = 0;
+	for (int cy = 0; cy < mask->rows; cy++) {
+		for (int cx = 0; cx < mask->columns; cx++) {
+			unsigned char id = ids[cy * HITMASK_CELL * mask->width + cx * HITMASK_CELL];
+			bool uniform = true;
+			for (int y = cy * HITMASK_CELL; uniform && y < fmin((cy + 1) * HITMASK_CELL, mask->height); y++) {
+				for (int x = cx * HITMASK_CELL; x < fmin((cx + 1) * HITMASK_CELL, mask->width); x++) {
+					if (ids[y * mask->width + x] != id) {
+						uniform = false;
+						break;
+					}
+				}
+			}
+			mask->cells[cy * mask->columns + cx] = uniform ? id : (HITMASK_MIXED | mixed++);
+		}
+	}
+
+	mask->blocks = calloc(mixed, HITMASK_CELL * HITMASK_CELL);
+	for (int i = 0; i < mask->columns * mask->rows; i++) {
+		if (!(mask->cells[i] & HITMASK_MIXED)) {
+			continue;
+		}
+		unsigned char* block = mask->blocks + (mask->cells[i] & ~HITMASK_MIXED) * HITMASK_CELL * HITMASK_CELL;
+		int cx = i % mask->columns, cy = i / mask->columns;
+		for (int y = cy * HITMASK_CELL; y < fmin((cy + 1) * HITMASK_CELL, mask->height); y++) {
+			memcpy(block + (y % HITMASK_CELL) * HITMASK_CELL, ids + y * mask->width + cx * HITMASK_CELL, fmin(HITMASK_CELL, mask->width - cx * HITMASK_CELL));
+		}
+	}
+	free(ids);
+
+	return mask;
+}
+
+struct HitMask* CreateHitMask(ALLEGRO_BITMAP* bitmap) {
+	return CreateHotspotMask(bitmap, NULL, 0);
+}
+
+struct HitMask* LoadHotspotMask(struct Game* game, char* filename, const unsigned char (*colors)[3], int count) {
+	double start = al_get_time();
+	UseAssetPack(game);
+	RecordSceneAsset(game, filename);
+	int flags = al_get_new_bitmap_flags();
+	al_set_new_bitmap_flags(flags | ALLEGRO_MEMORY_BITMAP);
+	// lookups are in normalized coordinates, so a lower resolution variant works just as well
+	char* path = FindTieredFile(game, filename, game->data->tier);
+	ALLEGRO_BITMAP* bitmap = al_load_bitmap(path ? path : GetDataFilePath(game, filename));
+	al_set_new_bitmap_flags(flags);
+	free(path);
+
+	struct HitMask* mask = CreateHotspotMask(bitmap, colors, count);
+	al_destroy_bitmap(bitmap);
+	ProfileSpan(game, "asset", filename, start);
+	return mask;
+}
+
+struct HitMask* LoadHitMask(struct Game* game, char* filename) {
+	return LoadHotspotMask(game, filename, NULL, 0);
+}
+
+void DestroyHitMask(struct HitMask* mask) {
+	free(mask->cells);
+	free(mask->blocks);
+	free(mask);
+}
+
+int GetHotspot(struct HitMask* mask, double x, double y) {
+	int px = (int)(x * mask->width), py = (int)(y * mask->height);
+	if (px < 0 || py < 0 || px >= mask->width || py >= mask->height) {
+		return -1;
+	}
+	uint32_t cell = mask->cells[(py / HITMASK_CELL) * mask->columns + px / HITMASK_CELL];
+	if (cell & HITMASK_MIXED) {
+		cell = mask->blocks[(cell & ~HITMASK_MIXED) * HITMASK_CELL * HITMASK_CELL + (py % HITMASK_CELL) * HITMASK_CELL + px % HITMASK_CELL];
+	}
+	return (int)cell - 1;
+}
+
+bool TestHitMask(struct HitMask* mask, double x, double y) {
+	return GetHotspot(mask, x, y) >= 0;
+}
+
+void CheckMask(struct Game* game, struct HitMask* mask) {
+	double start = al_get_time();
+	game->data->hover = TestHitMask(mask, game->data->mouseX, game->data->mouseY);
+	ProfileSpan(game, "mask", "CheckMask", start);
+}
+
+uint64_t HashData(const unsigned char* data, size_t size) {
+	uint64_t hash = 14695981039346656037ULL; // FNV-1a
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static struct CachedFrame* FindCachedFrame(struct Game* game, ALLEGRO_BITMAP* bitmap) {
+	struct CachedFrame* frame = game->data->frames.list;
+	while (frame && frame->bitmap != bitmap) {
+		frame = frame->next;
+	}
+	return frame;
+}
+
+// Has to be called with frames.mutex locked. Width and height of 0 match any, as they aren't known
+// before decoding unless the frame cache has them.
+static struct CachedFrame* FindFrame(struct Game* game, uint64_t hash, int64_t size, int width, int height) {
+	struct CachedFrame* frame = game->data->frames.list;
+	while (frame && (frame->hash != hash || frame->size != size ||
+		(width && frame->width != width) || (height && frame->height != height))) {
+		frame = frame->next;
+	}
+	return frame;
+}
+
+static ALLEGRO_BITMAP* ShareFrame(struct Game* game, uint64_t hash, int64_t size, int width, int height) {
+	al_lock_mutex(game->data->frames.mutex);
+	struct CachedFrame* frame = FindFrame(game, hash, size, width, height);
+	if (frame) {
+		frame->refs++;
+	}
+	al_unlock_mutex(game->data->frames.mutex);
+	return frame ? frame->bitmap : NULL;
+}
+
+static ALLEGRO_BITMAP* AddFrame(struct Game* game, uint64_t hash, int64_t size, ALLEGRO_BITMAP* bitmap, bool* decoded) {
+	int width = al_get_bitmap_width(bitmap), height = al_get_bitmap_height(bitmap);
+	al_lock_mutex(game->data->frames.mutex);
+	// another thread could have decoded the same contents in the meantime
+	struct CachedFrame* frame = FindFrame(game, hash, size, width, height);
+	if (frame) {
+		frame->refs++;
+		al_unlock_mutex(game->data->frames.mutex);
+		al_destroy_bitmap(bitmap);
+		*decoded = false;
+		return frame->bitmap;
+	}
+
+	frame = calloc(1, sizeof(struct CachedFrame));
+	frame->hash = hash;
+	frame->size = size;
+	frame->width = width;
+	frame->height = height;
+	frame->bitmap = bitmap;
+	frame->refs = 1;
+	frame->next = game->data->frames.list;
+	game->data->frames.list = frame;
+	al_unlock_mutex(game->data->frames.mutex);
+
+	*decoded = true;
+	return bitmap;
+}
+
+// Returns a bitmap decoded from given file, shared with every other frame with the same contents.
+static ALLEGRO_BITMAP* AcquireFrame(struct Game* game, const char* filename, bool* decoded) {
+	*decoded = false;
+
+	// compressed frames are ready to upload as they are
+	char* cache = NULL;
+	int64_t mtime = 0, size = 0;
+	const char* ext = strrchr(filename, '.');
+	if (game->data->frames.cache && !(ext && strcmp(ext, ".dds") == 0)) {
+		ALLEGRO_FS_ENTRY* entry = al_create_fs_entry(filename);
+		if (al_fs_entry_exists(entry)) {
+			mtime = al_get_fs_entry_mtime(entry);
+			size = al_get_fs_entry_size(entry);
+			cache = GetFrameCachePath(game, filename, mtime, size);
+		}
+		al_destroy_fs_entry(entry);
+	}
+
+	if (cache) {
+		struct FrameCacheHeader header;
+		if (ReadFrameCacheHeader(cache, mtime, size, &header)) {
+			// the header knows the contents hash, so shared frames don't even need their pixels read
+			ALLEGRO_BITMAP* bitmap = ShareFrame(game, header.hash, header.size, header.width, header.height);
+			if (!bitmap) {
+				double start = al_get_time();
+				bitmap = LoadFrameCache(cache, &header);
+				ProfileSpan(game, "asset", filename, start);
+				if (bitmap) {
+					bitmap = AddFrame(game, header.hash, header.size, bitmap, decoded);
+				}
+			}
+			if (bitmap) {
+				__atomic_add_fetch(&game->data->frames.hits, 1, __ATOMIC_RELAXED);
+				free(cache);
+				return bitmap;
+			}
+		}
+		__atomic_add_fetch(&game->data->frames.misses, 1, __ATOMIC_RELAXED);
+	}
+
+	// packed frames get hashed and decoded right from the mapping
+	int64_t length;
+	unsigned char* buffer = NULL;
+	const unsigned char* contents = GetPackedFile(filename, &length);
+	if (!contents) {
+		ALLEGRO_FILE* file = al_fopen(filename, "rb");
+		if (!file) {
+			free(cache);
+			return NULL;
+		}
+		length = al_fsize(file);
+		buffer = malloc(length);
+		length = al_fread(file, buffer, length);
+		al_fclose(file);
+		contents = buffer;
+	}
+
+	uint64_t hash = HashData(contents, length);
+	ALLEGRO_BITMAP* bitmap = ShareFrame(game, hash, length, 0, 0);
+	if (bitmap) {
+		free(buffer);
+		free(cache);
+		return bitmap;
+	}
+
+	double start = al_get_time();
+	ALLEGRO_FILE* memfile = al_open_memfile((void*)contents, length, "r");
+	bitmap = al_load_bitmap_f(memfile, ext);
+	al_fclose(memfile);
+	free(buffer);
+	ProfileSpan(game, "asset", filename, start);
+	if (!bitmap) {
+		free(cache);
+		return NULL;
+	}
 
-void SwitchScene(struct Game* game, char* name) {
-	if (game->data->next) {
-		free(game->data->next);
+	if (cache) {
+		SaveFrameCache(game, cache, filename, mtime, size, hash, bitmap);
+		free(cache);
 	}
-	game->data->next = strdup(name);
-	LoadGamestate(game, name);
-	SwitchCurrentGamestate(game, "myszka");
+	return AddFrame(game, hash, length, bitmap, decoded);
 }
 
-void PreLogic(struct Game* game, double delta) {
-	game->data->hover = false;
+static void ReleaseFrame(struct Game* game, struct CachedFrame* frame) {
+	al_lock_mutex(game->data->frames.mutex);
+	frame->refs--;
+	if (!frame->refs) {
+		struct CachedFrame** tmp = &game->data->frames.list;
+		while (*tmp != frame) {
+			tmp = &(*tmp)->next;
+		}
+		*tmp = frame->next;
+		al_destroy_bitmap(frame->bitmap);
+		free(frame);
+	}
+	al_unlock_mutex(game->data->frames.mutex);
+}
+
+// Returns the path to a DXT1 variant of given photo frame if one was built. The caller frees it.
+static char* FindCompressedFrame(struct Game* game, const char* filename) {
+	const char* ext = strrchr(filename, '.');
+	if (!ext || (strcmp(ext, ".jpg") != 0 && strcmp(ext, ".JPG") != 0)) {
+		return NULL;
+	}
+	char dds[255];
+	snprintf(dds, sizeof(dds), "%.*s.dds", (int)(ext - filename), filename);
+	return FindDataFilePath(game, dds);
+}
+
+struct DecodeJob {
+	struct Game* game;
+	int flags, format; // new bitmap settings of the loading thread, as they're thread-local
+	int count, next, done;
+	char** paths;
+	struct Spritesheet** spritesheets;
+	struct SpritesheetFrame** frames;
+	ALLEGRO_BITMAP** bitmaps;
+	bool* fresh;
+	ALLEGRO_MUTEX* mutex;
+	ALLEGRO_COND* cond;
+};
+
+static void* DecodeThread(ALLEGRO_THREAD* thread, void* arg) {
+	struct DecodeJob* job = arg;
+	UseAssetPack(job->game);
+	al_set_new_bitmap_flags(job->flags);
+	al_set_new_bitmap_format(job->format);
+	al_lock_mutex(job->mutex);
+	while (job->next < job->count) {
+		int i = job->next++;
+		al_unlock_mutex(job->mutex);
+		job->bitmaps[i] = AcquireFrame(job->game, job->paths[i], &job->fresh[i]);
+		al_lock_mutex(job->mutex);
+		job->done++;
+		al_signal_cond(job->cond);
+	}
+	al_unlock_mutex(job->mutex);
+	return NULL;
+}
+
+static void NoProgress(struct Game* game) {}
+
+void LoadCachedSpritesheets(struct Game* game, struct Character* character, void (*progress)(struct Game*)) {
+	// Frames are decoded on a pool of worker threads and filled in with sub-bitmaps of cached ones
+	// before LoadSpritesheets gets to them, so it only has to take care of whatever is left (like atlases).
+	// Uploading them to the GPU is still done by the engine on the main thread once loading is done.
+	int referenced = 0, decoded = 0, total = 0;
+	double saved = 0, start = al_get_time();
+	UseAssetPack(game);
+
+	struct DecodeJob job = {.game = game, .flags = al_get_new_bitmap_flags(), .format = al_get_new_bitmap_format()};
+	struct Spritesheet* tmp = character->spritesheets;
+	while (tmp) {
+		char ini[255];
+		snprintf(ini, sizeof(ini), "sprites/%s/%s.ini", character->name, tmp->name);
+		RecordSceneAsset(game, ini);
+		total += tmp->frameCount;
+		job.count += tmp->frameCount;
+		tmp = tmp->next;
+	}
+	job.paths = calloc(job.count, sizeof(char*));
+	job.spritesheets = calloc(job.count, sizeof(struct Spritesheet*));
+	job.frames = calloc(job.count, sizeof(struct SpritesheetFrame*));
+	job.bitmaps = calloc(job.count, sizeof(ALLEGRO_BITMAP*));
+	job.fresh = calloc(job.count, sizeof(bool));
+	job.count = 0;
+
+	// paths are resolved here, as GetDataFilePath isn't meant to be called from multiple threads
+	tmp = character->spritesheets;
+	while (tmp) {
+		// Lower resolution variants are only used when the whole spritesheet has them, as the scale
+		// that brings them back to their logical size is set per spritesheet.
+		int tier = game->data->tier;
+		for (int i = 0; tier > 1 && i < tmp->frameCount; i++) {
+			char filename[255] = {0};
+			snprintf(filename, 255, "sprites/%s/%s", character->name, tmp->frames[i].file ? tmp->frames[i].file : "");
+			char* path = (tmp->frames[i].bitmap || !tmp->frames[i].file) ? NULL : FindTieredFile(game, filename, tier);
+			if (!path) {
+				tier = 1;
+			}
+			free(path);
+		}
+		tmp->scale *= tier;
+
+		for (int i = 0; i < tmp->frameCount; i++) {
+			if (tmp->frames[i].bitmap || !tmp->frames[i].file) {
+				continue;
+			}
+			char filename[255] = {0};
+			snprintf(filename, 255, "sprites/%s/%s", character->name, tmp->frames[i].file);
+			char* path = FindTieredFile(game, filename, tier);
+			if (!path && game->data->compressed) {
+				path = FindCompressedFrame(game, filename);
+			}
+			job.paths[job.count] = path ? path : strdup(GetDataFilePath(game, filename)); // found paths are ours already
+			job.spritesheets[job.count] = tmp;
+			job.frames[job.count] = &tmp->frames[i];
+			job.count++;
+		}
+		tmp = tmp->next;
+	}
+
+	int workers = al_get_cpu_count();
+	if (workers > job.count) {
+		workers = job.count;
+	}
+	if (workers < 1) {
+		workers = 1;
+	}
+	ALLEGRO_THREAD** threads = calloc(workers, sizeof(ALLEGRO_THREAD*));
+	job.mutex = al_create_mutex();
+	job.cond = al_create_cond();
+	int started = 0;
+	for (int i = 0; i < workers; i++) {
+		threads[started] = al_create_thread(DecodeThread, &job);
+		if (!threads[started]) {
+			PrintConsole(game, "Could not create a decoding thread!");
+			continue;
+		}
+		al_start_thread(threads[started++]);
+	}
+	if (!started) {
+		// no workers, so this thread has to do it all by itself
+		DecodeThread(NULL, &job);
+	}
+
+	// report progress from this thread as the workers finish frames
+	int reported = 0;
+	al_lock_mutex(job.mutex);
+	while (reported < job.count) {
+		while (job.done == reported) {
+			al_wait_cond(job.cond, job.mutex);
+		}
+		int done = job.done;
+		al_unlock_mutex(job.mutex);
+		for (; reported < done; reported++) {
+			progress(game);
+		}
+		al_lock_mutex(job.mutex);
+	}
+	al_unlock_mutex(job.mutex);
+
+	for (int i = 0; i < started; i++) {
+		al_destroy_thread(threads[i]);
+	}
+	free(threads);
+	al_destroy_cond(job.cond);
+	al_destroy_mutex(job.mutex);
+
+	for (int i = 0; i < job.count; i++) {
+		free(job.paths[i]);
+		ALLEGRO_BITMAP* bitmap = job.bitmaps[i];
+		if (!bitmap) {
+			continue;
+		}
+		tmp = job.spritesheets[i];
+		int width = al_get_bitmap_width(bitmap), height = al_get_bitmap_height(bitmap);
+		job.frames[i]->bitmap = al_create_sub_bitmap(bitmap, 0, 0, width, height);
+		if (width > tmp->width) {
+			tmp->width = width;
+		}
+		if (height > tmp->height) {
+			tmp->height = height;
+		}
+		referenced++;
+		if (job.fresh[i]) {
+			decoded++;
+		} else {
+			saved += width * height * 4 / (1024.0 * 1024.0);
+		}
+	}
+	free(job.paths);
+	free(job.spritesheets);
+	free(job.frames);
+	free(job.bitmaps);
+	free(job.fresh);
+
+	// progress of the decoded frames is already reported, so it's accounted for the remaining ones separately
+	LoadSpritesheets(game, character, NoProgress);
+	for (; reported < total; reported++) {
+		progress(game);
+	}
+	ProfileSpan(game, "asset", character->name, start);
+
+	game->data->frames.saved += saved;
+	PrintConsole(game, "Frames of %s: %d referenced, %d decoded on %d threads, %.1f MB saved (%.1f MB in total)", character->name, referenced, decoded, workers, saved, game->data->frames.saved);
+	if (game->data->frames.cache) {
+		PrintConsole(game, "Frame cache: %d hits, %d misses, %d written, %.1f MB on disk", game->data->frames.hits, game->data->frames.misses,
+			game->data->frames.writes, game->data->frames.disk / (1024.0 * 1024.0));
+	}
+}
+
+void DestroyCachedCharacter(struct Game* game, struct Character* character) {
+	if (!character->shared) {
+		struct Spritesheet* tmp = character->spritesheets;
+		while (tmp) {
+			for (int i = 0; i < tmp->frameCount; i++) {
+				if (!tmp->frames[i].bitmap || !al_is_sub_bitmap(tmp->frames[i].bitmap)) {
+					continue;
+				}
+				struct CachedFrame* frame = FindCachedFrame(game, al_get_parent_bitmap(tmp->frames[i].bitmap));
+				if (frame) {
+					al_destroy_bitmap(tmp->frames[i].bitmap);
+					tmp->frames[i].bitmap = NULL;
+					ReleaseFrame(game, frame);
+				}
+			}
+			tmp = tmp->next;
+		}
+	}
+	DestroyCharacter(game, character);
+}
+
+static struct CachedAsset* GetAsset(struct Game* game, char* filename, enum AssetType type) {
+	struct CachedAsset* asset = game->data->assets.list;
+	while (asset && (asset->type != type || strcmp(asset->path, filename) != 0)) {
+		asset = asset->next;
+	}
+	if (!asset) {
+		asset = calloc(1, sizeof(struct CachedAsset));
+		asset->path = strdup(filename);
+		asset->type = type;
+		asset->next = game->data->assets.list;
+		game->data->assets.list = asset;
+	}
+	if (asset->data) {
+		asset->hits++;
+	}
+	asset->refs++;
+	return asset;
+}
+
+static void FinishAssetLoad(struct Game* game, struct CachedAsset* asset, double start) {
+	double time = al_get_time() - start;
+	ProfileSpan(game, "asset", asset->path, start);
+	asset->loads++;
+	asset->time += time;
+	PrintConsole(game, "Asset %s loaded in %.1f ms (%.1f KB)", asset->path, time * 1000.0, asset->size / 1024.0);
+}
+
+static void DropAsset(struct Game* game, struct CachedAsset* asset) {
+	// Called when loading failed, so the entry doesn't stay around holding a NULL for the next caller.
+	PrintConsole(game, "Could not load asset %s!", asset->path);
+	asset->refs--;
+	if (asset->refs || asset->loads) {
+		return; // keep the stats of earlier loads, the next acquire is going to retry anyway
+	}
+	struct CachedAsset** prev = &game->data->assets.list;
+	while (*prev != asset) {
+		prev = &(*prev)->next;
+	}
+	*prev = asset->next;
+	free(asset->path);
+	free(asset);
+}
+
+static void ReleaseAsset(struct Game* game, struct CachedAsset* asset) {
+	asset->refs--;
+	if (asset->refs) {
+		return;
+	}
+	if (asset->type == ASSET_STREAM && asset->policy == AUDIO_SHARED) {
+		return; // other scenes are going to come back for it
+	}
+	switch (asset->type) {
+		case ASSET_BITMAP:
+			al_destroy_bitmap(asset->data);
+			break;
+		case ASSET_SAMPLE:
+			al_destroy_sample(asset->data);
+			break;
+		case ASSET_STREAM:
+			if (!asset->mapped) {
+				free(asset->data);
+			}
+			break;
+		case ASSET_FONT:
+			al_destroy_font(asset->data);
+			break;
+	}
+	asset->data = NULL;
+}
+
+static struct CachedAsset* FindAsset(struct Game* game, void* data) {
+	struct CachedAsset* asset = game->data->assets.list;
+	while (asset && asset->data != data) {
+		asset = asset->next;
+	}
+	return asset;
+}
+
+ALLEGRO_BITMAP* AcquireBitmap(struct Game* game, char* filename) {
+	UseAssetPack(game);
+	RecordSceneAsset(game, filename);
+	al_lock_mutex(game->data->assets.mutex);
+	struct CachedAsset* asset = GetAsset(game, filename, ASSET_BITMAP);
+	if (!asset->data) {
+		double start = al_get_time();
+		asset->data = al_load_bitmap(GetDataFilePath(game, filename));
+		if (!asset->data) {
+			DropAsset(game, asset);
+			al_unlock_mutex(game->data->assets.mutex);
+			return NULL;
+		}
+		asset->size = (int64_t)al_get_bitmap_width(asset->data) * al_get_bitmap_height(asset->data) * 4;
+		FinishAssetLoad(game, asset, start);
+	}
+	al_unlock_mutex(game->data->assets.mutex);
+	return asset->data;
+}
+
+ALLEGRO_SAMPLE* AcquireSample(struct Game* game, char* filename) {
+	UseAssetPack(game);
+	RecordSceneAsset(game, filename);
+	al_lock_mutex(game->data->assets.mutex);
+	struct CachedAsset* asset = GetAsset(game, filename, ASSET_SAMPLE);
+	if (!asset->data) {
+		double start = al_get_time();
+		asset->data = al_load_sample(GetDataFilePath(game, filename));
+		if (!asset->data) {
+			DropAsset(game, asset);
+			al_unlock_mutex(game->data->assets.mutex);
+			return NULL;
+		}
+		asset->size = (int64_t)al_get_sample_length(asset->data) * al_get_channel_count(al_get_sample_channels(asset->data)) * al_get_audio_depth_size(al_get_sample_depth(asset->data));
+		FinishAssetLoad(game, asset, start);
+	}
+	al_unlock_mutex(game->data->assets.mutex);
+	return asset->data;
+}
+
+static const char* AUDIO_POLICY_NAMES[AUDIO_POLICIES] = {"stream", "decode", "shared"};
+
+static void WriteWavInt(unsigned char* data, uint32_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) {
+		data[i] = (value >> (i * 8)) & 0xff;
+	}
+}
+
+// Replaces the source file held by given asset with its decoded contents, as a 16-bit PCM WAV image
+// that Allegro streams without any decoder work.
+static bool DecodeAudio(struct Game* game, struct CachedAsset* asset, const char* ext) {
+	double start = al_get_time();
+	ALLEGRO_FILE* memfile = al_open_memfile(asset->data, asset->size, "r");
+	ALLEGRO_SAMPLE* sample = al_load_sample_f(memfile, ext);
+	al_fclose(memfile);
+	if (!sample) {
+		return false;
+	}
+	if (al_get_sample_depth(sample) != ALLEGRO_AUDIO_DEPTH_INT16) {
+		// the WAV loader only takes 8 and 16-bit PCM
+		al_destroy_sample(sample);
+		return false;
+	}
+	int channels = al_get_channel_count(al_get_sample_channels(sample));
+	unsigned int frequency = al_get_sample_frequency(sample);
+	uint32_t bytes = al_get_sample_length(sample) * channels * 2;
+	unsigned char* wav = malloc(44 + bytes);
+	memcpy(wav, "RIFF", 4);
+	WriteWavInt(wav + 4, 36 + bytes, 4);
+	memcpy(wav + 8, "WAVEfmt ", 8);
+	WriteWavInt(wav + 16, 16, 4);
+	WriteWavInt(wav + 20, 1, 2); // PCM
+	WriteWavInt(wav + 22, channels, 2);
+	WriteWavInt(wav + 24, frequency, 4);
+	WriteWavInt(wav + 28, frequency * channels * 2, 4);
+	WriteWavInt(wav + 32, channels * 2, 2);
+	WriteWavInt(wav + 34, 16, 2);
+	memcpy(wav + 36, "data", 4);
+	WriteWavInt(wav + 40, bytes, 4);
+	// samples are in native byte order, which is little endian on everything the game runs on
+	memcpy(wav + 44, al_get_sample_data(sample), bytes);
+	game->data->audio.duration[asset->policy] += al_get_sample_length(sample) / (double)frequency;
+	al_destroy_sample(sample);
+
+	if (!asset->mapped) {
+		free(asset->data);
+	}
+	asset->data = wav;
+	asset->size = 44 + bytes;
+	asset->mapped = false;
+	game->data->audio.decode[asset->policy] += al_get_time() - start;
+	return true;
+}
+
+static enum AudioPolicy PickAudioPolicy(struct Game* game, struct CachedAsset* asset, const char* ext) {
+	const char* policy = GetConfigOptionDefault(game, "odlot-audio", asset->path, "auto");
+	for (int i = 0; i < AUDIO_POLICIES; i++) {
+		if (strcmp(policy, AUDIO_POLICY_NAMES[i]) == 0) {
+			return i;
+		}
+	}
+	// Streaming costs decoder time for as long as the track plays, decoding costs memory for as long
+	// as it's loaded. Short ones are cheap to keep decoded, and worth keeping for good if they come
+	// back in several scenes.
+	ALLEGRO_FILE* memfile = al_open_memfile(asset->data, asset->size, "r");
+	ALLEGRO_AUDIO_STREAM* probe = al_load_audio_stream_f(memfile, ext, 2, 1024);
+	if (!probe) {
+		al_fclose(memfile);
+		return AUDIO_STREAM;
+	}
+	int64_t decoded = al_get_audio_stream_length_secs(probe) * al_get_audio_stream_frequency(probe) *
+		al_get_channel_count(al_get_audio_stream_channels(probe)) * al_get_audio_depth_size(al_get_audio_stream_depth(probe));
+	al_destroy_audio_stream(probe);
+	if (decoded > game->data->audio.limit) {
+		return AUDIO_STREAM;
+	}
+	return CountSceneUses(game, asset->path) > 1 ? AUDIO_SHARED : AUDIO_DECODE;
+}
+
+ALLEGRO_AUDIO_STREAM* AcquireAudioStream(struct Game* game, char* filename, size_t buffer_count, unsigned int samples) {
+	// Streams have their own playback state, so only the source file contents (or the decoded audio,
+	// depending on the policy) get shared; every stream reads from its own memfile on top of them.
+	// Packed files are used in place.
+	UseAssetPack(game);
+	RecordSceneAsset(game, filename);
+	const char* ext = strrchr(filename, '.');
+	al_lock_mutex(game->data->assets.mutex);
+	struct CachedAsset* asset = GetAsset(game, filename, ASSET_STREAM);
+	if (!asset->data) {
+		double start = al_get_time();
+		char* path = GetDataFilePath(game, filename);
+		const unsigned char* packed = GetPackedFile(path, &asset->size);
+		asset->mapped = packed != NULL;
+		if (packed) {
+			asset->data = (void*)packed;
+		} else {
+			ALLEGRO_FILE* file = al_fopen(path, "rb");
+			if (!file) {
+				DropAsset(game, asset);
+				al_unlock_mutex(game->data->assets.mutex);
+				return NULL;
+			}
+			asset->size = al_fsize(file);
+			asset->data = malloc(asset->size);
+			asset->size = al_fread(file, asset->data, asset->size);
+			al_fclose(file);
+		}
+		asset->policy = PickAudioPolicy(game, asset, ext);
+		if (asset->policy != AUDIO_STREAM && !DecodeAudio(game, asset, ext)) {
+			asset->policy = AUDIO_STREAM;
+		}
+		game->data->audio.files[asset->policy]++;
+		game->data->audio.bytes[asset->policy] += asset->size;
+		PrintConsole(game, "Audio %s: %s", filename, AUDIO_POLICY_NAMES[asset->policy]);
+		FinishAssetLoad(game, asset, start);
+	}
+
+	ALLEGRO_FILE* memfile = al_open_memfile(asset->data, asset->size, "r");
+	ALLEGRO_AUDIO_STREAM* stream = al_load_audio_stream_f(memfile, asset->policy == AUDIO_STREAM ? ext : ".wav", buffer_count, samples);
+	if (!stream) {
+		PrintConsole(game, "Could not open audio stream %s!", filename);
+		al_fclose(memfile);
+		ReleaseAsset(game, asset);
+		al_unlock_mutex(game->data->assets.mutex);
+		return NULL;
+	}
+
+	struct CachedStream* cached = calloc(1, sizeof(struct CachedStream));
+	cached->stream = stream;
+	cached->asset = asset;
+	cached->next = game->data->assets.streams;
+	game->data->assets.streams = cached;
+	al_unlock_mutex(game->data->assets.mutex);
+	return stream;
+}
+
+ALLEGRO_FONT* AcquireFont(struct Game* game, char* filename, int size) {
+	// Shared per file and size, so every scene using the same font draws from the same glyph cache.
+	char key[255];
+	snprintf(key, sizeof(key), "%s:%d", filename, size);
+	UseAssetPack(game);
+	RecordSceneAsset(game, filename);
+	al_lock_mutex(game->data->assets.mutex);
+	struct CachedAsset* asset = GetAsset(game, key, ASSET_FONT);
+	if (!asset->data) {
+		double start = al_get_time();
+		asset->data = al_load_font(GetDataFilePath(game, filename), size, 0);
+		if (!asset->data) {
+			DropAsset(game, asset);
+			al_unlock_mutex(game->data->assets.mutex);
+			return NULL;
+		}
+		FinishAssetLoad(game, asset, start);
+	}
+	al_unlock_mutex(game->data->assets.mutex);
+	return asset->data;
+}
+
+void ReleaseBitmap(struct Game* game, ALLEGRO_BITMAP* bitmap) {
+	al_lock_mutex(game->data->assets.mutex);
+	ReleaseAsset(game, FindAsset(game, bitmap));
+	al_unlock_mutex(game->data->assets.mutex);
+}
+
+void ReleaseSample(struct Game* game, ALLEGRO_SAMPLE* sample) {
+	al_lock_mutex(game->data->assets.mutex);
+	ReleaseAsset(game, FindAsset(game, sample));
+	al_unlock_mutex(game->data->assets.mutex);
+}
+
+void ReleaseFont(struct Game* game, ALLEGRO_FONT* font) {
+	al_lock_mutex(game->data->assets.mutex);
+	ReleaseAsset(game, FindAsset(game, font));
+	al_unlock_mutex(game->data->assets.mutex);
+}
+
+void ReleaseAudioStream(struct Game* game, ALLEGRO_AUDIO_STREAM* stream) {
+	al_lock_mutex(game->data->assets.mutex);
+	struct CachedStream** tmp = &game->data->assets.streams;
+	while ((*tmp)->stream != stream) {
+		tmp = &(*tmp)->next;
+	}
+	struct CachedStream* cached = *tmp;
+	*tmp = cached->next;
+	// the stream closes its memfile, so it has to go before the contents it reads from
+	al_destroy_audio_stream(stream);
+	ReleaseAsset(game, cached->asset);
+	free(cached);
+	al_unlock_mutex(game->data->assets.mutex);
+}
+
+void PrintAssetStats(struct Game* game) {
+	struct CachedAsset* asset = game->data->assets.list;
+	while (asset) {
+		PrintConsole(game, "%s: %d loads, %d shared, %.1f KB, %.1f ms", asset->path, asset->loads, asset->hits, asset->size / 1024.0, asset->time * 1000.0);
+		asset = asset->next;
+	}
+
+	// Decoding speed measured on the decoded files tells how much a streamed one costs while it plays.
+	double decode = game->data->audio.decode[AUDIO_DECODE] + game->data->audio.decode[AUDIO_SHARED];
+	double duration = game->data->audio.duration[AUDIO_DECODE] + game->data->audio.duration[AUDIO_SHARED];
+	for (int i = 0; i < AUDIO_POLICIES; i++) {
+		if (!game->data->audio.files[i]) {
+			continue;
+		}
+		if (i == AUDIO_STREAM && duration > 0) {
+			PrintConsole(game, "Audio %s: %d loads, %.1f MB loaded, decoding while playing takes ~%.2f%% CPU per track", AUDIO_POLICY_NAMES[i],
+				game->data->audio.files[i], game->data->audio.bytes[i] / (1024.0 * 1024.0), decode / duration * 100.0);
+		} else if (i == AUDIO_STREAM) {
+			PrintConsole(game, "Audio %s: %d loads, %.1f MB loaded, decoded while playing", AUDIO_POLICY_NAMES[i],
+				game->data->audio.files[i], game->data->audio.bytes[i] / (1024.0 * 1024.0));
+		} else {
+			PrintConsole(game, "Audio %s: %d loads, %.1f MB loaded, %.1f ms spent decoding on load, no CPU while playing", AUDIO_POLICY_NAMES[i],
+				game->data->audio.files[i], game->data->audio.bytes[i] / (1024.0 * 1024.0), game->data->audio.decode[i] * 1000.0);
+		}
+	}
+}
+
+struct Video* OpenVideo(struct Game* game, char* filename) {
+	struct Video* video = calloc(1, sizeof(struct Video));
+	UseAssetPack(game);
+	RecordSceneAsset(game, filename);
+	video->video = al_open_video(GetDataFilePath(game, filename));
+	video->name = strdup(filename);
+	return video;
+}
+
+void PrerollVideo(struct Game* game, struct Video* video, ALLEGRO_MIXER* mixer) {
+	// Starting the video spins up the decoder threads, which fill their buffers while it's paused,
+	// so the first frame is already there when playback gets started. Needs the display, so call it
+	// from Gamestate_PostLoad.
+	al_start_video(video->video, mixer);
+	al_set_video_playing(video->video, false);
+	video->fps = al_get_video_fps(video->video);
+	video->frame = al_get_video_frame(video->video);
+	video->position = -1;
+}
+
+void PlayVideo(struct Game* game, struct Video* video, bool playing) {
+	al_set_video_playing(video->video, playing);
+}
+
+void RewindVideo(struct Game* game, struct Video* video) {
+	if (al_get_video_position(video->video, ALLEGRO_VIDEO_POSITION_ACTUAL) > 0) {
+		al_seek_video(video->video, 0);
+	}
+	video->position = -1;
+}
+
+ALLEGRO_BITMAP* GetVideoFrame(struct Game* game, struct Video* video) {
+	ALLEGRO_BITMAP* frame = al_get_video_frame(video->video);
+	if (frame) {
+		video->frame = frame;
+	}
+	if (!al_is_video_playing(video->video) || video->fps <= 0) {
+		return video->frame;
+	}
+
+	double position = al_get_video_position(video->video, ALLEGRO_VIDEO_POSITION_ACTUAL);
+	if (position != video->position) {
+		// frames that should have been shown since the previous one never made it to the screen
+		if (video->position >= 0) {
+			int skipped = (int)((position - video->position) * video->fps + 0.5) - 1;
+			if (skipped > 0) {
+				video->dropped += skipped;
+			}
+		}
+		// decoder fell behind the playback clock
+		if (al_get_video_position(video->video, ALLEGRO_VIDEO_POSITION_VIDEO_DECODE) < position) {
+			video->late++;
+		}
+		video->shown++;
+		video->position = position;
+	}
+	return video->frame;
+}
+
+double GetVideoPosition(struct Video* video) {
+	return al_get_video_position(video->video, ALLEGRO_VIDEO_POSITION_ACTUAL);
+}
+
+void CloseVideo(struct Game* game, struct Video* video) {
+	PrintConsole(game, "Video %s: %d frames shown, %d dropped, %d late", video->name, video->shown, video->dropped, video->late);
+	al_close_video(video->video);
+	free(video->name);
+	free(video);
+}
+
+static void PercussionCallback(void* buffer, unsigned int samples, void* userdata) {
+	// runs on the audio thread, right after the fragment with any fresh hits in it has been mixed
+	struct Game* game = userdata;
+	game->data->percussion.fragment = samples;
+	int64_t pending = __atomic_exchange_n(&game->data->percussion.pending, 0, __ATOMIC_ACQ_REL);
+	if (pending && game->data->percussion.count < PERCUSSION_HITS) {
+		game->data->percussion.latencies[game->data->percussion.count++] = al_get_time() - pending / 1000000.0;
+	}
+}
+
+static char* GetAudioBackend(void) {
+	// Allegro doesn't tell which driver its autodetection settled on, so only a configured one gets named
+	const char* driver = al_get_config_value(al_get_system_config(), "audio", "driver");
+	return strdup((driver && *driver && strcmp(driver, "default") != 0) ? driver : "auto");
+}
+
+static void SetupPercussion(struct Game* game) {
+	int fragment = strtol(GetConfigOptionDefault(game, "odlot", "audio_fragment", "0"), NULL, 10);
+	if (fragment > 0) {
+		// The backends take their buffer sizes from the system config when a voice gets created, so the
+		// voice set up by the engine has to be replaced to make the smaller fragments take effect.
+		char size[16];
+		snprintf(size, sizeof(size), "%d", fragment);
+		al_set_config_value(al_get_system_config(), "alsa", "buffer_size", size);
+		al_set_config_value(al_get_system_config(), "pulseaudio", "buffer_size", size);
+		al_set_config_value(al_get_system_config(), "directsound", "buffer_size", size);
+
+		unsigned int frequency = al_get_mixer_frequency(game->audio.mixer);
+		al_detach_mixer(game->audio.mixer);
+		al_destroy_voice(game->audio.v);
+		game->audio.v = al_create_voice(frequency, ALLEGRO_AUDIO_DEPTH_INT16, ALLEGRO_CHANNEL_CONF_2);
+		if (!game->audio.v) {
+			game->audio.v = al_create_voice(frequency, ALLEGRO_AUDIO_DEPTH_FLOAT32, ALLEGRO_CHANNEL_CONF_2);
+		}
+		if (game->audio.v) {
+			al_attach_mixer_to_voice(game->audio.mixer, game->audio.v);
+		} else {
+			PrintConsole(game, "Could not create a voice with %d sample fragments!", fragment);
+		}
+	}
+
+	game->data->percussion.backend = GetAudioBackend();
+
+	game->data->percussion.mixer = al_create_mixer(al_get_mixer_frequency(game->audio.fx), ALLEGRO_AUDIO_DEPTH_FLOAT32, ALLEGRO_CHANNEL_CONF_2);
+	al_attach_mixer_to_mixer(game->data->percussion.mixer, game->audio.fx);
+	al_set_mixer_postprocess_callback(game->data->percussion.mixer, PercussionCallback, game);
+}
+
+void ArmSample(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance) {
+	// Runs the instance through the mixer once, silently, so the first real hit doesn't pay for
+	// touching the sample data and setting up the resampler on the audio thread.
+	al_set_sample_instance_playmode(instance, ALLEGRO_PLAYMODE_ONCE);
+	al_set_sample_instance_gain(instance, 0.0);
+	al_set_sample_instance_position(instance, 0);
+	al_set_sample_instance_playing(instance, true);
+}
+
+void TriggerSample(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance, double timestamp) {
+	// rewinding a playing instance avoids the extra stop, which takes the mixer lock on its own
+	al_set_sample_instance_gain(instance, 1.0);
+	al_set_sample_instance_position(instance, 0);
+	al_set_sample_instance_playing(instance, true);
+	if (timestamp > 0) {
+		__atomic_store_n(&game->data->percussion.pending, (int64_t)(timestamp * 1000000.0), __ATOMIC_RELEASE);
+	}
+}
+
+static void DestroyPercussion(struct Game* game) {
+	// detaching waits for the audio thread, so the measurements can't change anymore afterwards
+	al_detach_mixer(game->data->percussion.mixer);
+	al_destroy_mixer(game->data->percussion.mixer);
+}
+
+void SetTextLayer(struct Game* game, struct TextLayer* layer, ALLEGRO_FONT* font, int spacing, const char** lines, int count) {
+	bool changed = layer->font != font || layer->spacing != spacing || layer->count != count;
+	for (int i = 0; !changed && i < count; i++) {
+		changed = strcmp(layer->lines[i], lines[i] ? lines[i] : "") != 0;
+	}
+	if (!changed) {
+		return;
+	}
+
+	for (int i = 0; i < layer->count; i++) {
+		free(layer->lines[i]);
+	}
+	layer->font = font;
+	layer->spacing = spacing;
+	layer->count = count;
+	layer->width = 0;
+	for (int i = 0; i < count; i++) {
+		layer->lines[i] = strdup(lines[i] ? lines[i] : "");
+		int width = al_get_text_width(font, layer->lines[i]);
+		if (width > layer->width) {
+			layer->width = width;
+		}
+	}
+	layer->height = count ? (count - 1) * spacing + al_get_font_line_height(font) : 0;
+
+	if (!layer->width || !layer->height) {
+		return;
+	}
+	if (!layer->bitmap || al_get_bitmap_width(layer->bitmap) < layer->width || al_get_bitmap_height(layer->bitmap) < layer->height) {
+		if (layer->bitmap) {
+			al_destroy_bitmap(layer->bitmap);
+		}
+		layer->bitmap = CreateNotPreservedBitmap(layer->width, layer->height);
+	}
+
+	double start = al_get_time();
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+	al_set_target_bitmap(layer->bitmap);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	// white, so the layer can be tinted with any color when drawn
+	for (int i = 0; i < count; i++) {
+		al_draw_text(font, al_map_rgb(255, 255, 255), 0, i * spacing, ALLEGRO_ALIGN_LEFT, layer->lines[i]);
+	}
+	al_restore_state(&state);
+	ProfileSpan(game, "text", "SetTextLayer", start);
+}
+
+void DrawTextLayer(struct Game* game, struct TextLayer* layer, ALLEGRO_COLOR color, float x, float y) {
+	if (!layer->bitmap || !layer->width || !layer->height) {
+		return;
+	}
+	al_draw_tinted_bitmap_region(layer->bitmap, color, 0, 0, layer->width, layer->height, x, y, 0);
+}
+
+void ClearTextLayer(struct TextLayer* layer) {
+	for (int i = 0; i < layer->count; i++) {
+		free(layer->lines[i]);
+	}
+	layer->count = 0;
+	layer->width = 0;
+	layer->height = 0;
+}
+
+void DestroyTextLayer(struct TextLayer* layer) {
+	ClearTextLayer(layer);
+	if (layer->bitmap) {
+		al_destroy_bitmap(layer->bitmap);
+	}
+	layer->bitmap = NULL;
+}
+
+void InvalidateSceneCache(struct SceneCache* cache) {
+	cache->valid = false;
+}
+
+void MarkDirty(struct SceneCache* cache, float x, float y, float w, float h) {
+	if (!cache->dirty) {
+		cache->x1 = x;
+		cache->y1 = y;
+		cache->x2 = x + w;
+		cache->y2 = y + h;
+		cache->dirty = true;
+		return;
+	}
+	cache->x1 = fmin(cache->x1, x);
+	cache->y1 = fmin(cache->y1, y);
+	cache->x2 = fmax(cache->x2, x + w);
+	cache->y2 = fmax(cache->y2, y + h);
+}
+
+bool BeginSceneCache(struct Game* game, struct SceneCache* cache) {
+	ALLEGRO_BITMAP* target = al_get_target_bitmap();
+	if (!cache->bitmap || al_get_bitmap_width(cache->bitmap) != al_get_bitmap_width(target) || al_get_bitmap_height(cache->bitmap) != al_get_bitmap_height(target)) {
+		if (cache->bitmap) {
+			al_destroy_bitmap(cache->bitmap);
+		}
+		cache->bitmap = CreateNotPreservedBitmap(al_get_bitmap_width(target), al_get_bitmap_height(target));
+		cache->valid = false;
+	}
+	if (cache->valid && !cache->dirty) {
+		cache->drawing = false;
+		return false;
+	}
+
+	// draw into the cache using the same transformation the framebuffer has
+	ALLEGRO_TRANSFORM transform;
+	al_copy_transform(&transform, al_get_current_transform());
+	al_store_state(&cache->state, ALLEGRO_STATE_TARGET_BITMAP);
+	al_set_target_bitmap(cache->bitmap);
+	al_use_transform(&transform);
+
+	if (cache->valid) {
+		float x1 = cache->x1, y1 = cache->y1, x2 = cache->x2, y2 = cache->y2;
+		al_transform_coordinates(&transform, &x1, &y1);
+		al_transform_coordinates(&transform, &x2, &y2);
+		// a pixel of margin for filtering
+		al_set_clipping_rectangle(floor(x1) - 1, floor(y1) - 1, ceil(x2 - x1) + 3, ceil(y2 - y1) + 3);
+	}
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+
+	cache->drawing = true;
+	cache->valid = true;
+	cache->dirty = false;
+	return true;
+}
+
+void EndSceneCache(struct Game* game, struct SceneCache* cache) {
+	if (cache->drawing) {
+		al_reset_clipping_rectangle();
+		al_restore_state(&cache->state);
+		cache->drawing = false;
+	}
+
+	ALLEGRO_TRANSFORM transform, identity;
+	al_copy_transform(&transform, al_get_current_transform());
+	al_identity_transform(&identity);
+	al_use_transform(&identity);
+	al_draw_bitmap(cache->bitmap, 0, 0, 0);
+	al_use_transform(&transform);
 }
 
-void CheckMask(struct Game* game, ALLEGRO_BITMAP* bitmap) {
-	ALLEGRO_COLOR color = al_get_pixel(bitmap, (int)(game->data->mouseX * game->viewport.width), (int)(game->data->mouseY * game->viewport.height));
-	game->data->hover = color.r < 1.0;
+void DestroySceneCache(struct SceneCache* cache) {
+	if (cache->bitmap) {
+		al_destroy_bitmap(cache->bitmap);
+	}
+	cache->bitmap = NULL;
+	cache->valid = false;
 }
 
 void DrawTexturedRectangle(float x1, float y1, float x2, float y2, ALLEGRO_COLOR color) {
@@ -69,15 +2210,33 @@ void DrawTexturedRectangle(float x1, float y1, float x2, float y2, ALLEGRO_COLOR
 }
 
 void Compositor(struct Game* game, struct Gamestate* gamestates) {
+	// The engine runs the compositor from within its drawing, before the postdraw handler,
+	// so this is where the scenes are done drawing.
+	if (game->data->profile.start[PROFILE_DRAW]) {
+		ProfileStage(game, PROFILE_DRAW, "draw", game->data->profile.start[PROFILE_DRAW]);
+		game->data->profile.start[PROFILE_DRAW] = 0;
+	}
 	struct Gamestate* tmp = gamestates;
+	if (game->data->benchmark.enabled) {
+		BenchmarkFrame(game);
+	}
+	double start = al_get_time();
+
+	// With a single scene there's nothing under it to blend with, so it's written over the cleared
+	// backbuffer without reading it back. The full clear stays, as it's the cheap one on tiled GPUs.
+	bool single = CountActiveScenes(game) == 1 && !game->_priv.loading.shown;
 	ClearToColor(game, al_map_rgb(0, 0, 0));
+	if (single) {
+		al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+	}
 
 	al_use_shader(game->data->grain);
-	al_set_shader_float("time", game->time);
 
 	if (game->_priv.loading.shown) {
+		SetGrainUniforms(game, game->data->noise, game->loading_fb);
 		al_draw_bitmap(game->loading_fb, game->_priv.clip_rect.x, game->_priv.clip_rect.y, 0);
 		al_use_shader(NULL);
+		RestoreFramebuffers(game);
 		return;
 	}
 
@@ -92,16 +2251,30 @@ void Compositor(struct Game* game, struct Gamestate* gamestates) {
 
 			float color = 1.0 + (rand() / (double)RAND_MAX) * 0.01 - 0.005;
 
+			SetGrainUniforms(game, game->data->noise, tmp->fb);
+
 			al_draw_tinted_scaled_rotated_bitmap(tmp->fb, al_map_rgba_f(color, color, color, color), 0, 0,
 				game->_priv.clip_rect.x + randx, game->_priv.clip_rect.y + randy, game->_priv.clip_rect.w / (double)al_get_bitmap_width(tmp->fb) * 1.01, game->_priv.clip_rect.h / (double)al_get_bitmap_height(tmp->fb) * 1.01, 0.0, 0);
 		}
 		tmp = tmp->next;
 	}
 	al_use_shader(NULL);
+	if (single) {
+		al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
+	}
 
 	if (game->data->cursor) {
 		al_draw_scaled_rotated_bitmap(game->data->hover ? game->data->cursorhover : game->data->cursorbmp, 130, 165, game->data->mouseX * game->_priv.clip_rect.w + game->_priv.clip_rect.x, game->data->mouseY * game->_priv.clip_rect.h + game->_priv.clip_rect.y, game->_priv.clip_rect.w / (double)game->viewport.width * 0.1, game->_priv.clip_rect.h / (double)game->viewport.height * 0.1, 0, 0);
 	}
+
+	RestoreFramebuffers(game);
+
+	ProfileStage(game, PROFILE_COMPOSITOR, "compositor", start);
+	FinishProfileFrame(game);
+	UpdateDynamicResolution(game, game->data->profile.frames[(game->data->profile.frame - 1) % PROFILE_FRAMES]);
+	if (game->data->profile.overlay) {
+		DrawProfileOverlay(game);
+	}
 }
 
 bool GlobalEventHandler(struct Game* game, ALLEGRO_EVENT* ev) {
@@ -127,6 +2300,22 @@ bool GlobalEventHandler(struct Game* game, ALLEGRO_EVENT* ev) {
 		PrintConsole(game, "Fullscreen toggled");
 	}
 
+	if ((ev->type == ALLEGRO_EVENT_KEY_DOWN) && (ev->keyboard.keycode == ALLEGRO_KEY_P)) {
+		game->data->profile.overlay = !game->data->profile.overlay;
+	}
+
+	if ((ev->type == ALLEGRO_EVENT_KEY_DOWN) && (ev->keyboard.keycode == ALLEGRO_KEY_T)) {
+		ExportTrace(game);
+	}
+
+	if (game->data->benchmark.enabled) {
+		// the benchmark drives the cursor on its own
+		if (ev->type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN && ev->any.source != &game->event_source) {
+			return true;
+		}
+		return false;
+	}
+
 	if (ev->type == ALLEGRO_EVENT_MOUSE_AXES) {
 		game->data->mouseX = Clamp(0, 1, (ev->mouse.x - game->_priv.clip_rect.x) / (double)game->_priv.clip_rect.w);
 		game->data->mouseY = Clamp(0, 1, (ev->mouse.y - game->_priv.clip_rect.y) / (double)game->_priv.clip_rect.h);
@@ -143,24 +2332,108 @@ void HideMouse(struct Game* game) {
 	game->data->cursor = false;
 }
 
+static int PickTier(struct Game* game) {
+	const char* tier = GetConfigOptionDefault(game, "odlot", "tier", "auto");
+	if (strcmp(tier, "auto") != 0) {
+		int divisor = strtol(tier, NULL, 10);
+		return (divisor == 2 || divisor == 4) ? divisor : 1;
+	}
+	// the one closest to the size of the output, with the thresholds halfway between tiers on a log scale
+	if (game->_priv.clip_rect.w <= 0) {
+		return 1;
+	}
+	double ratio = game->viewport.width / (double)game->_priv.clip_rect.w;
+	if (ratio >= 2.0 * M_SQRT2) {
+		return 4;
+	}
+	if (ratio >= M_SQRT2) {
+		return 2;
+	}
+	return 1;
+}
+
 struct CommonResources* CreateGameData(struct Game* game) {
 	struct CommonResources* data = calloc(1, sizeof(struct CommonResources));
-	data->grain = CreateShader(game, GetDataFilePath(game, "shaders/vertex.glsl"), GetDataFilePath(game, "shaders/grain.glsl"));
+	// "texture" trades the per-pixel noise math for a lookup into pregenerated noise, for weaker GPUs
+	if (strcmp(GetConfigOptionDefault(game, "odlot", "grain", "procedural"), "texture") == 0) {
+		data->noise = CreateNoiseBitmap();
+	}
+	data->grain = CreateGrainShader(game, data->noise != NULL);
 	data->first_load = true;
 	data->mouseX = -1;
 	data->mouseY = -1;
 	data->cursor = false;
+	data->residency.lookahead = strtol(GetConfigOptionDefault(game, "odlot", "lookahead", "2"), NULL, 10);
+	data->residency.budget = strtol(GetConfigOptionDefault(game, "odlot", "budget", "512"), NULL, 10);
+	data->prefetch.mutex = al_create_mutex();
+	data->manifest.mutex = al_create_mutex();
+	data->frames.mutex = al_create_mutex();
+	game->data = data; // the setup below goes through game, and the percussion mixer callback keeps using it
+	OpenAssetPack(game);
+	SetupFrameCache(game);
+	LoadSceneManifest(game);
+	data->assets.mutex = al_create_mutex();
+	data->audio.limit = strtol(GetConfigOptionDefault(game, "odlot", "audio_decode_mb", "8"), NULL, 10) * 1024 * 1024;
+	data->profile.mutex = al_create_mutex();
+	data->profile.events = calloc(PROFILE_EVENTS, sizeof(struct ProfileEvent));
+	data->profile.font = al_create_builtin_font();
+	// photo frames get uploaded as DXT1 when the driver can take it, uncompressed otherwise
+	data->compressed = strtol(GetConfigOptionDefault(game, "odlot", "compressed", "1"), NULL, 10) &&
+		(al_have_opengl_extension("GL_EXT_texture_compression_s3tc") || al_have_opengl_extension("GL_EXT_texture_compression_dxt1"));
+	PrintConsole(game, "Compressed textures: %s", data->compressed ? "yes" : "no");
+	SetupPercussion(game);
+	SetupAudioClocks(game);
+	SetupDynamicResolution(game);
+	data->tier = PickTier(game);
+	PrintConsole(game, "Asset tier: 1/%d", data->tier);
 	data->cursorbmp = al_load_bitmap(GetDataFilePath(game, "kursor_normal.webp"));
 	data->cursorhover = al_load_bitmap(GetDataFilePath(game, "kursor_hover.webp"));
 	return data;
 }
 
 void DestroyGameData(struct Game* game) {
+	DestroyPercussion(game);
+	DestroyAudioClocks(game);
+	if (game->data->benchmark.enabled) {
+		WriteBenchmark(game);
+	}
 	if (game->data->next) {
 		free(game->data->next);
 	}
+	StopPrefetch(game);
+	al_destroy_mutex(game->data->prefetch.mutex);
+	SaveSceneManifest(game);
+	al_destroy_mutex(game->data->manifest.mutex);
+	al_destroy_mutex(game->data->frames.mutex);
+	free(game->data->frames.cache);
+	PrintAssetStats(game);
+	if (game->data->percussion.count) {
+		// the last mixed fragment still has to go through the device buffer before it's heard
+		qsort(game->data->percussion.latencies, game->data->percussion.count, sizeof(double), CompareDoubles);
+		PrintConsole(game, "Audio latency (%s): %d hits, %.2f ms median from event to mix, plus %.2f ms fragment", game->data->percussion.backend,
+			game->data->percussion.count, GetPercentile(game->data->percussion.latencies, game->data->percussion.count, 50), GetFragmentLength(game) * 1000.0);
+	}
+	free(game->data->percussion.backend);
+	RestoreFramebuffers(game); // nothing is in use outside of drawing, so this frees them all
+	while (game->data->assets.list) {
+		struct CachedAsset* asset = game->data->assets.list;
+		game->data->assets.list = asset->next;
+		if (asset->type == ASSET_STREAM && asset->policy == AUDIO_SHARED) {
+			free(asset->data); // kept after its last release
+		}
+		free(asset->path);
+		free(asset);
+	}
+	al_destroy_mutex(game->data->assets.mutex);
+	al_destroy_mutex(game->data->profile.mutex);
+	free(game->data->profile.events);
+	al_destroy_font(game->data->profile.font);
 	DestroyShader(game, game->data->grain);
+	if (game->data->noise) {
+		al_destroy_bitmap(game->data->noise);
+	}
 	al_destroy_bitmap(game->data->cursorbmp);
 	al_destroy_bitmap(game->data->cursorhover);
+	CloseAssetPack(game);
 	free(game->data);
 }
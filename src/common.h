@@ -18,20 +18,384 @@
 #define LIBSUPERDERPY_DATA_TYPE struct CommonResources
 #include <libsuperderpy.h>
 
+#define HITMASK_CELL 16 // pixels per side of a cell in the mask index
+#define HITMASK_MIXED 0x80000000u
+#define HITMASK_TOLERANCE (3 * 40 * 40)
+
+// Hotspot IDs of a mask bitmap, kept on the CPU so hit testing never has to touch the GPU.
+// The mask is split into a grid of cells, each of which is either covered by a single hotspot
+// or points to a block with the IDs of its pixels, so lookups take constant time.
+struct HitMask {
+	int width, height;
+	int columns, rows;
+	uint32_t* cells; // hotspot + 1 (0 for none), or HITMASK_MIXED | block index
+	unsigned char* blocks; // hotspot + 1 per pixel, HITMASK_CELL * HITMASK_CELL per block
+};
+
+// Data files a scene (or myszka) has acquired, as recorded while playing; kept between runs.
+struct SceneAssets {
+	char* name;
+	char** files;
+	int count;
+	bool recorded; // during this run, rather than read back from an earlier one
+	struct SceneAssets* next;
+};
+
+struct Prefetch {
+	struct Game* game;
+	ALLEGRO_THREAD* thread;
+	ALLEGRO_MUTEX* mutex;
+	char* target;
+	char** files;
+	int count, done;
+};
+
+#define FRAME_CACHE_VERSION 2
+
+// Start of every frame cache entry, see framecache.c.
+struct FrameCacheHeader {
+	char magic[4];
+	uint32_t version;
+	int64_t mtime, size; // of the source file
+	uint64_t hash; // of the source file contents
+	char source[512]; // path of the source file, so stale entries can be found
+	int32_t width, height; // followed by premultiplied ABGR_8888_LE pixels, row by row
+};
+
+#define PACK_VERSION 1
+
+struct PackEntry {
+	const char* path; // relative to the data directory
+	const unsigned char* data; // inside the mapping
+	int64_t size;
+};
+
+// The data files bundled by tools/pack.c, mapped into memory at once.
+struct AssetPack {
+	unsigned char* map;
+	size_t length;
+	struct PackEntry* entries; // sorted by path
+	char* names;
+	int count;
+	char* root; // data directory as it appears in paths returned by GetDataFilePath
+	time_t mtime; // of the pack, reported for every file in it
+};
+
+struct CachedFrame {
+	uint64_t hash; // of the file contents
+	int64_t size; // of the file contents, checked along with the hash and dimensions so a collision can't swap frames
+	int width, height;
+	ALLEGRO_BITMAP* bitmap;
+	int refs;
+	struct CachedFrame* next;
+};
+
+enum AssetType {
+	ASSET_BITMAP,
+	ASSET_SAMPLE,
+	ASSET_STREAM,
+	ASSET_FONT
+};
+
+enum AudioPolicy {
+	AUDIO_STREAM, // decoded while playing
+	AUDIO_DECODE, // decoded once when loaded, dropped along with the last scene using it
+	AUDIO_SHARED, // decoded once and kept around for the whole run
+	AUDIO_POLICIES
+};
+
+struct CachedAsset {
+	char* path;
+	enum AssetType type;
+	void* data; // ALLEGRO_BITMAP*, ALLEGRO_SAMPLE*, ALLEGRO_FONT* or raw contents of a stream source
+	int64_t size; // in bytes
+	bool mapped; // data points into the asset pack instead of being allocated
+	enum AudioPolicy policy; // of streams; decoded ones hold a WAV image instead of the source file
+	int refs;
+	int loads, hits;
+	double time; // spent loading, in seconds
+	struct CachedAsset* next;
+};
+
+struct CachedStream {
+	ALLEGRO_AUDIO_STREAM* stream;
+	struct CachedAsset* asset;
+	struct CachedStream* next;
+};
+
+struct BenchmarkScene {
+	char* name;
+	double load; // in seconds
+	double* frames; // frame times, in seconds
+	int count, size;
+	double peak; // in MB
+	struct BenchmarkScene* next;
+};
+
+#define PERCUSSION_HITS 1024 // latency measurements kept
+
+#define AUDIO_CLOCK_MIXERS 2 // music and fx
+
+// Frames mixed so far by a mixer, published from its postprocess callback without taking any lock.
+struct MixerClock {
+	ALLEGRO_MIXER* mixer;
+	unsigned int frequency;
+	unsigned int seq; // odd while being written
+	int64_t frames;
+	int64_t time; // when the last fragment got mixed, in microseconds
+	unsigned int fragment; // frames mixed per callback
+};
+
+struct AudioCue {
+	double progress; // fraction of the stream length
+	void (*callback)(struct Game*, void*);
+	void* data;
+	bool fired;
+	struct AudioCue* next;
+};
+
+// Playback position of a stream, worked out from the frames its mixer has mixed since the stream
+// started, so reading it doesn't take the mixer lock and isn't limited to the stream buffer size.
+struct AudioClock {
+	ALLEGRO_AUDIO_STREAM* stream;
+	struct MixerClock* mixer; // NULL if the stream isn't attached to one of the clocked mixers
+	double length; // in seconds
+	bool loop, playing;
+	int64_t start; // mixer frame the stream started playing at
+	double offset; // position at that frame, in seconds
+	double anchored; // when the position was last checked against the stream's own
+	int lap; // of a looping stream, cues get armed again on every one
+	struct AudioCue* cues;
+	struct AudioClock* next;
+};
+
+#define PROFILE_EVENTS 65536 // kept for trace export
+#define PROFILE_FRAMES 240 // shown in the overlay
+
+enum {
+	PROFILE_LOGIC,
+	PROFILE_DRAW,
+	PROFILE_COMPOSITOR,
+	PROFILE_STAGES
+};
+
+struct ProfileEvent {
+	char name[48];
+	const char* category;
+	double start, duration; // in seconds
+	int thread;
+};
+
+struct Video {
+	ALLEGRO_VIDEO* video;
+	char* name;
+	ALLEGRO_BITMAP* frame; // last one that came out of the decoder
+	double fps;
+	double position; // of the last shown frame, in seconds
+	int shown, dropped, late;
+};
+
+// Keeps what a gamestate has drawn, so frames where nothing (or only a part) has changed
+// don't have to be redrawn from scratch.
+struct SceneCache {
+	ALLEGRO_BITMAP* bitmap;
+	bool valid, drawing;
+	bool dirty;
+	float x1, y1, x2, y2; // dirty region in viewport coordinates
+	ALLEGRO_STATE state;
+};
+
+// Stands in for the framebuffer of a gamestate while the resolution is lowered.
+struct ScaledFramebuffer {
+	struct Gamestate* gamestate;
+	ALLEGRO_BITMAP *fb, *original;
+	bool used; // swapped in for the frame being drawn
+	struct ScaledFramebuffer* next;
+};
+
+#define TEXT_LINES 8
+
+// A block of text rasterized once, so drawing it takes a single quad instead of laying out
+// every glyph each frame.
+struct TextLayer {
+	ALLEGRO_BITMAP* bitmap;
+	ALLEGRO_FONT* font;
+	char* lines[TEXT_LINES];
+	int count, spacing;
+	int width, height; // of the used part of the bitmap
+};
+
 struct CommonResources {
 	// Fill in with common data accessible from all gamestates.
 	ALLEGRO_SHADER* grain;
+	ALLEGRO_BITMAP* noise; // sampled by the grain shader instead of computing noise per pixel, if set
 	double mouseX, mouseY;
 	bool first_load;
 	char* next;
 	bool cursor;
 	bool hover;
 	ALLEGRO_BITMAP *cursorbmp, *cursorhover;
+	bool compressed; // whether DXT1 variants of photo frames should be used
+	int tier; // resolution divisor of sprite frames and masks: 1, 2 or 4
+	struct AssetPack* pack; // NULL when running from loose files
+
+	struct {
+		int lookahead; // how many scenes ahead of the current one to keep loaded
+		int budget; // in MB
+	} residency;
+
+	struct Prefetch prefetch;
+
+	struct {
+		struct SceneAssets* list;
+		ALLEGRO_MUTEX* mutex;
+	} manifest;
+
+	struct {
+		struct CachedFrame* list;
+		ALLEGRO_MUTEX* mutex;
+		double saved; // in MB
+		char* cache; // directory with decoded frames from previous runs, if enabled
+		int64_t disk, budget; // in bytes
+		int hits, misses, writes;
+	} frames;
+
+	struct {
+		struct CachedAsset* list;
+		struct CachedStream* streams;
+		ALLEGRO_MUTEX* mutex;
+	} assets;
+
+	struct {
+		int64_t limit; // decoded size up to which a stream gets decoded up front, in bytes
+		int files[AUDIO_POLICIES];
+		int64_t bytes[AUDIO_POLICIES]; // held in memory by the loaded files, in total
+		double decode[AUDIO_POLICIES]; // spent decoding when loading, in seconds
+		double duration[AUDIO_POLICIES]; // of the decoded audio, in seconds
+	} audio;
+
+	struct {
+		bool enabled, timeout;
+		char* output;
+		double x, y; // where the current scene wants to be clicked
+		bool target;
+		int step;
+		double cooldown;
+		double requested, entered, last;
+		double grain[2]; // ms per full-screen pass, procedural and texture
+		struct BenchmarkScene *scenes, *current;
+	} benchmark;
+
+	struct {
+		bool enabled;
+		int step, steps; // current and number of allowed scales
+		double budget; // seconds per frame
+		double sum, worst; // frame times in the current window
+		double work; // logic, draw and compositor times in the current window
+		int frames;
+		double stable; // seconds spent within budget since the last change
+		double backoff; // seconds to stay within budget before going up again
+		double raised; // when the resolution went up last
+		struct ScaledFramebuffer* framebuffers;
+	} resolution;
+
+	struct {
+		ALLEGRO_MIXER* mixer; // for sounds that have to follow input right away
+		char* backend;
+		unsigned int fragment; // samples mixed per callback
+		int64_t pending; // event timestamp of the last hit that hasn't been mixed yet, in microseconds
+		double latencies[PERCUSSION_HITS]; // from the event to the end of the mix, in seconds
+		int count;
+	} percussion;
+
+	struct {
+		struct MixerClock mixers[AUDIO_CLOCK_MIXERS];
+		struct AudioClock* list;
+	} clocks;
+
+	struct {
+		struct ProfileEvent* events; // ring buffer
+		int count;
+		ALLEGRO_MUTEX* mutex;
+		double start[PROFILE_STAGES];
+		double current[PROFILE_STAGES]; // accumulated during the frame being rendered
+		double frames[PROFILE_FRAMES][PROFILE_STAGES + 1]; // whole frame time first, then stages
+		int frame;
+		double last;
+		bool overlay;
+		ALLEGRO_FONT* font;
+	} profile;
 };
 
 void SwitchScene(struct Game* game, char* name);
+void EnterScene(struct Game* game, char* name);
+void UpdateResidency(struct Game* game, char* name);
+double GetPrefetchProgress(struct Game* game);
+void StartBenchmark(struct Game* game, char* output);
+void BenchmarkTarget(struct Game* game, double x, double y);
 void PreLogic(struct Game* game, double delta);
-void CheckMask(struct Game* game, ALLEGRO_BITMAP* bitmap);
+void PostLogic(struct Game* game, double delta);
+void PreDraw(struct Game* game);
+void ProfileSpan(struct Game* game, const char* category, const char* name, double start);
+void ExportTrace(struct Game* game);
+int GetThreadId(void);
+uint64_t HashData(const unsigned char* data, size_t size);
+void SetupFrameCache(struct Game* game);
+char* GetFrameCachePath(struct Game* game, const char* filename, int64_t mtime, int64_t size);
+bool ReadFrameCacheHeader(const char* path, int64_t mtime, int64_t size, struct FrameCacheHeader* header);
+ALLEGRO_BITMAP* LoadFrameCache(const char* path, const struct FrameCacheHeader* header);
+void SaveFrameCache(struct Game* game, const char* path, const char* source, int64_t mtime, int64_t size, uint64_t hash, ALLEGRO_BITMAP* bitmap);
+struct HitMask* CreateHitMask(ALLEGRO_BITMAP* bitmap);
+struct HitMask* CreateHotspotMask(ALLEGRO_BITMAP* bitmap, const unsigned char (*colors)[3], int count);
+struct HitMask* LoadHitMask(struct Game* game, char* filename);
+struct HitMask* LoadHotspotMask(struct Game* game, char* filename, const unsigned char (*colors)[3], int count);
+void DestroyHitMask(struct HitMask* mask);
+int GetHotspot(struct HitMask* mask, double x, double y);
+bool TestHitMask(struct HitMask* mask, double x, double y);
+void CheckMask(struct Game* game, struct HitMask* mask);
+void UseAssetPack(struct Game* game);
+void OpenAssetPack(struct Game* game);
+void CloseAssetPack(struct Game* game);
+const unsigned char* GetPackedFile(const char* path, int64_t* size);
+void LoadCachedSpritesheets(struct Game* game, struct Character* character, void (*progress)(struct Game*));
+void DestroyCachedCharacter(struct Game* game, struct Character* character);
+ALLEGRO_BITMAP* AcquireBitmap(struct Game* game, char* filename);
+ALLEGRO_FONT* AcquireFont(struct Game* game, char* filename, int size);
+ALLEGRO_SAMPLE* AcquireSample(struct Game* game, char* filename);
+ALLEGRO_AUDIO_STREAM* AcquireAudioStream(struct Game* game, char* filename, size_t buffer_count, unsigned int samples);
+void ReleaseBitmap(struct Game* game, ALLEGRO_BITMAP* bitmap);
+void ReleaseSample(struct Game* game, ALLEGRO_SAMPLE* sample);
+void ReleaseFont(struct Game* game, ALLEGRO_FONT* font);
+void ReleaseAudioStream(struct Game* game, ALLEGRO_AUDIO_STREAM* stream);
+void PrintAssetStats(struct Game* game);
+struct Video* OpenVideo(struct Game* game, char* filename);
+void PrerollVideo(struct Game* game, struct Video* video, ALLEGRO_MIXER* mixer);
+void PlayVideo(struct Game* game, struct Video* video, bool playing);
+void RewindVideo(struct Game* game, struct Video* video);
+ALLEGRO_BITMAP* GetVideoFrame(struct Game* game, struct Video* video);
+double GetVideoPosition(struct Video* video);
+void CloseVideo(struct Game* game, struct Video* video);
+void ArmSample(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance);
+void TriggerSample(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance, double timestamp);
+struct AudioClock* CreateAudioClock(struct Game* game, ALLEGRO_AUDIO_STREAM* stream, ALLEGRO_MIXER* mixer);
+void PlayAudioClock(struct Game* game, struct AudioClock* clock, bool playing);
+void RewindAudioClock(struct Game* game, struct AudioClock* clock);
+double GetAudioClockPosition(struct Game* game, struct AudioClock* clock);
+double GetAudioClockProgress(struct Game* game, struct AudioClock* clock);
+void AddAudioCue(struct Game* game, struct AudioClock* clock, double progress, void (*callback)(struct Game*, void*), void* data);
+void SetupAudioClocks(struct Game* game);
+void DestroyAudioClocks(struct Game* game);
+void DispatchAudioCues(struct Game* game);
+void DestroyAudioClock(struct Game* game, struct AudioClock* clock);
+void SetTextLayer(struct Game* game, struct TextLayer* layer, ALLEGRO_FONT* font, int spacing, const char** lines, int count);
+void DrawTextLayer(struct Game* game, struct TextLayer* layer, ALLEGRO_COLOR color, float x, float y);
+void ClearTextLayer(struct TextLayer* layer);
+void DestroyTextLayer(struct TextLayer* layer);
+void InvalidateSceneCache(struct SceneCache* cache);
+void MarkDirty(struct SceneCache* cache, float x, float y, float w, float h);
+bool BeginSceneCache(struct Game* game, struct SceneCache* cache);
+void EndSceneCache(struct Game* game, struct SceneCache* cache);
+void DestroySceneCache(struct SceneCache* cache);
 void DrawTexturedRectangle(float x1, float y1, float x2, float y2, ALLEGRO_COLOR color);
 struct CommonResources* CreateGameData(struct Game* game);
 void DestroyGameData(struct Game* game);
@@ -0,0 +1,255 @@
+/*! \file framecache.c
+ *  \brief Decoded spritesheet frames kept on disk between runs.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+#include <time.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <process.h>
+#endif
+
+// Decoded frames from previous runs are kept in the user data directory, so warm starts only
+// have to read pixels instead of decoding JPEGs and WebPs again. Raw pixels take several times
+// more space than the compressed sources, so this only pays off on storage that reads much faster
+// than the CPU decodes (not SD cards or network shares) and is off unless enabled.
+
+static int GetPid(void) {
+#if defined(__unix__) || defined(__APPLE__)
+	return getpid();
+#elif defined(_WIN32)
+	return _getpid();
+#else
+	return 0;
+#endif
+}
+
+static void RemoveCacheDirectory(ALLEGRO_FS_ENTRY* dir) {
+	if (al_open_directory(dir)) {
+		ALLEGRO_FS_ENTRY* file;
+		while ((file = al_read_directory(dir))) {
+			al_remove_fs_entry(file);
+			al_destroy_fs_entry(file);
+		}
+		al_close_directory(dir);
+	}
+	al_remove_fs_entry(dir);
+}
+
+// Caches of other versions can't be read anymore, so they're removed as a whole.
+static void RemoveOtherFrameCaches(struct Game* game, const char* current) {
+	ALLEGRO_PATH* path = al_get_standard_path(ALLEGRO_USER_DATA_PATH);
+	ALLEGRO_FS_ENTRY* entry = al_create_fs_entry(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+	al_destroy_path(path);
+	if (al_open_directory(entry)) {
+		ALLEGRO_FS_ENTRY* dir;
+		while ((dir = al_read_directory(entry))) {
+			ALLEGRO_PATH* name = al_create_path(al_get_fs_entry_name(dir));
+			const char* filename = al_get_path_filename(name);
+			if ((al_get_fs_entry_mode(dir) & ALLEGRO_FILEMODE_ISDIR) && strncmp(filename, "frames-v", 8) == 0 && strcmp(filename, current) != 0) {
+				PrintConsole(game, "Removing old frame cache %s", al_get_fs_entry_name(dir));
+				RemoveCacheDirectory(dir);
+			}
+			al_destroy_path(name);
+			al_destroy_fs_entry(dir);
+		}
+		al_close_directory(entry);
+	}
+	al_destroy_fs_entry(entry);
+}
+
+// Entries are keyed by the mtime and size of their source, so once a source changes its old entry
+// would never be read again. Those (and temporary files left by runs that didn't finish writing)
+// are removed, and the rest is counted against the budget.
+static void PruneFrameCache(struct Game* game) {
+	int pruned = 0;
+	ALLEGRO_FS_ENTRY* entry = al_create_fs_entry(game->data->frames.cache);
+	if (al_open_directory(entry)) {
+		ALLEGRO_FS_ENTRY* file;
+		while ((file = al_read_directory(entry))) {
+			const char* name = al_get_fs_entry_name(file);
+			const char* ext = strrchr(name, '.');
+			bool valid = false;
+			if (ext && strcmp(ext, ".tmp") == 0) {
+				valid = time(NULL) - al_get_fs_entry_mtime(file) < 3600; // could still be written by another run
+			} else {
+				struct FrameCacheHeader header;
+				ALLEGRO_FILE* f = al_fopen(name, "rb");
+				if (f) {
+					valid = al_fread(f, &header, sizeof(header)) == sizeof(header) &&
+						memcmp(header.magic, "ODFC", 4) == 0 && header.version == FRAME_CACHE_VERSION;
+					al_fclose(f);
+				}
+				if (valid) {
+					header.source[sizeof(header.source) - 1] = '\0';
+					ALLEGRO_FS_ENTRY* source = al_create_fs_entry(header.source);
+					valid = al_fs_entry_exists(source) && al_get_fs_entry_mtime(source) == header.mtime && (int64_t)al_get_fs_entry_size(source) == header.size;
+					al_destroy_fs_entry(source);
+				}
+			}
+			if (valid) {
+				game->data->frames.disk += al_get_fs_entry_size(file);
+			} else if (al_remove_fs_entry(file)) {
+				pruned++;
+			}
+			al_destroy_fs_entry(file);
+		}
+		al_close_directory(entry);
+	}
+	al_destroy_fs_entry(entry);
+	if (pruned) {
+		PrintConsole(game, "Frame cache: removed %d stale entries", pruned);
+	}
+}
+
+void SetupFrameCache(struct Game* game) {
+	if (!strtol(GetConfigOptionDefault(game, "odlot", "frame_cache", "0"), NULL, 10)) {
+		return;
+	}
+	// raw frames are big, so there's a limit on how much of the disk they can take
+	game->data->frames.budget = strtoll(GetConfigOptionDefault(game, "odlot", "frame_cache_mb", "2048"), NULL, 10) * 1024 * 1024;
+
+	char dir[32];
+	snprintf(dir, sizeof(dir), "frames-v%d", FRAME_CACHE_VERSION);
+	RemoveOtherFrameCaches(game, dir);
+	ALLEGRO_PATH* path = al_get_standard_path(ALLEGRO_USER_DATA_PATH);
+	al_append_path_component(path, dir);
+	const char* dirname = al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP);
+	if (!al_make_directory(dirname)) {
+		PrintConsole(game, "Could not create frame cache directory %s!", dirname);
+		al_destroy_path(path);
+		return;
+	}
+	game->data->frames.cache = strdup(dirname);
+	al_destroy_path(path);
+
+	PruneFrameCache(game);
+	PrintConsole(game, "Frame cache: %s (%.1f MB)", game->data->frames.cache, game->data->frames.disk / (1024.0 * 1024.0));
+}
+
+char* GetFrameCachePath(struct Game* game, const char* filename, int64_t mtime, int64_t size) {
+	char key[512];
+	snprintf(key, sizeof(key), "%s:%lld:%lld", filename, (long long)mtime, (long long)size);
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.frame", (unsigned long long)HashData((const unsigned char*)key, strlen(key)));
+	ALLEGRO_PATH* path = al_create_path_for_directory(game->data->frames.cache);
+	al_set_path_filename(path, name);
+	char* result = strdup(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+	al_destroy_path(path);
+	return result;
+}
+
+bool ReadFrameCacheHeader(const char* path, int64_t mtime, int64_t size, struct FrameCacheHeader* header) {
+	ALLEGRO_FILE* file = al_fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	bool valid = al_fread(file, header, sizeof(*header)) == sizeof(*header) &&
+		memcmp(header->magic, "ODFC", 4) == 0 && header->version == FRAME_CACHE_VERSION &&
+		header->mtime == mtime && header->size == size &&
+		header->width > 0 && header->height > 0 && header->width <= 16384 && header->height <= 16384 &&
+		// a truncated file would blow up once mapped
+		al_fsize(file) == (int64_t)sizeof(*header) + (int64_t)header->width * header->height * 4;
+	al_fclose(file);
+	return valid;
+}
+
+ALLEGRO_BITMAP* LoadFrameCache(const char* path, const struct FrameCacheHeader* header) {
+	ALLEGRO_BITMAP* bitmap = al_create_bitmap(header->width, header->height);
+	if (!bitmap) {
+		return NULL;
+	}
+	size_t row = header->width * 4;
+	bool loaded = false;
+	ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+#if defined(__unix__) || defined(__APPLE__)
+	size_t length = sizeof(*header) + row * header->height;
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		unsigned char* data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			madvise(data, length, MADV_SEQUENTIAL);
+			for (int y = 0; y < header->height; y++) {
+				memcpy((unsigned char*)region->data + y * region->pitch, data + sizeof(*header) + y * row, row);
+			}
+			munmap(data, length);
+			loaded = true;
+		}
+		close(fd);
+	}
+#else
+	ALLEGRO_FILE* file = al_fopen(path, "rb");
+	if (file) {
+		loaded = al_fseek(file, sizeof(*header), ALLEGRO_SEEK_SET);
+		for (int y = 0; loaded && y < header->height; y++) {
+			loaded = al_fread(file, (unsigned char*)region->data + y * region->pitch, row) == row;
+		}
+		al_fclose(file);
+	}
+#endif
+	al_unlock_bitmap(bitmap);
+	if (!loaded) {
+		al_destroy_bitmap(bitmap);
+		return NULL;
+	}
+	return bitmap;
+}
+
+void SaveFrameCache(struct Game* game, const char* path, const char* source, int64_t mtime, int64_t size, uint64_t hash, ALLEGRO_BITMAP* bitmap) {
+	struct FrameCacheHeader header = {.magic = {'O', 'D', 'F', 'C'}, .version = FRAME_CACHE_VERSION, .mtime = mtime, .size = size, .hash = hash};
+	if (strlen(source) >= sizeof(header.source)) {
+		return; // couldn't be pruned
+	}
+	strncpy(header.source, source, sizeof(header.source) - 1);
+	header.width = al_get_bitmap_width(bitmap);
+	header.height = al_get_bitmap_height(bitmap);
+	size_t row = header.width * 4;
+	int64_t length = sizeof(header) + (int64_t)row * header.height;
+	if (__atomic_add_fetch(&game->data->frames.disk, length, __ATOMIC_RELAXED) > game->data->frames.budget) {
+		__atomic_sub_fetch(&game->data->frames.disk, length, __ATOMIC_RELAXED);
+		return;
+	}
+
+	// written under a temporary name first (unique to this process and thread), so other runs never see a partial file
+	char tmp[1024];
+	snprintf(tmp, sizeof(tmp), "%s.%d.%d.tmp", path, GetPid(), GetThreadId());
+	ALLEGRO_FILE* file = al_fopen(tmp, "wb");
+	if (!file) {
+		__atomic_sub_fetch(&game->data->frames.disk, length, __ATOMIC_RELAXED);
+		return;
+	}
+	bool written = al_fwrite(file, &header, sizeof(header)) == sizeof(header);
+	ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+	for (int y = 0; written && y < header.height; y++) {
+		written = al_fwrite(file, (unsigned char*)region->data + y * region->pitch, row) == row;
+	}
+	al_unlock_bitmap(bitmap);
+	written = al_fclose(file) && written;
+
+	if (written && rename(tmp, path) == 0) {
+		__atomic_add_fetch(&game->data->frames.writes, 1, __ATOMIC_RELAXED);
+	} else {
+		remove(tmp);
+		__atomic_sub_fetch(&game->data->frames.disk, length, __ATOMIC_RELAXED);
+	}
+}
@@ -68,10 +68,11 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "myszki.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "myszki.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
 	al_set_audio_stream_gain(data->music, 1.0);
@@ -80,7 +81,7 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 
 	data->altanka = CreateCharacter(game, "altanka");
 	RegisterSpritesheet(game, data->altanka, "altanka");
-	LoadSpritesheets(game, data->altanka, progress);
+	LoadCachedSpritesheets(game, data->altanka, progress);
 
 	return data;
 }
@@ -88,8 +89,8 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
-	DestroyCharacter(game, data->altanka);
+	ReleaseAudioStream(game, data->music);
+	DestroyCachedCharacter(game, data->altanka);
 	free(data);
 }
 
@@ -25,6 +25,7 @@ struct GamestateResources {
 	// This struct is for every resource allocated and used by your gamestate.
 	// It gets created on load and then gets passed around to all other function calls.
 	ALLEGRO_BITMAP* bg;
+	struct HitMask* mask;
 	ALLEGRO_SAMPLE_INSTANCE* bongo[5];
 	ALLEGRO_SAMPLE* sample[5];
 	ALLEGRO_AUDIO_STREAM* music;
@@ -36,36 +37,25 @@ struct GamestateResources {
 	int user[4];
 };
 
-int Gamestate_ProgressCount = 7; // number of loading steps as reported by Gamestate_Load; 0 when missing
-
-static int GetBongo(struct Game* game, struct GamestateResources* data) {
-	int x = (int)(game->data->mouseX * 1920);
-	int y = (int)(game->data->mouseY * 1080);
-	int b = -1;
-	if ((x > 537) && (y > 150) && (x < 537 + 219) && (y < 160 + 76)) {
-		b = 0;
-	} else if ((x > 537) && (y > 313) && (x < 537 + 301) && (y < 313 + 125)) {
-		b = 1;
-	} else if ((x > 845) && (y > 441) && (x < 845 + 321) && (y < 441 + 130)) {
-		b = 2;
-	} else if ((x > 1135) && (y > 361) && (x < 1135 + 285) && (y < 361 + 111)) {
-		b = 3;
-	} else if ((x > 1101) && (y > 269) && (x < 1101 + 272) && (y < 269 + 103)) {
-		b = 4;
-	}
-	return b;
-}
+int Gamestate_ProgressCount = 8; // number of loading steps as reported by Gamestate_Load; 0 when missing
+
+// colors of the drums in bongomask.webp
+static const unsigned char BONGOS[5][3] = {{0, 0, 0}, {0, 255, 0}, {0, 0, 255}, {255, 255, 0}, {0, 255, 255}};
 
 void Gamestate_Logic(struct Game* game, struct GamestateResources* data, double delta) {
 	// Here you should do all your game logic as if <delta> seconds have passed.
-	if (GetBongo(game, data) > -1) {
-		game->data->hover = true;
+	CheckMask(game, data->mask);
+
+	if (data->counter > 130) {
+		// centers of the drums in bongomask.webp
+		static const double bongos[5][2] = {{646, 193}, {687, 375}, {1005, 506}, {1277, 416}, {1237, 320}};
+		BenchmarkTarget(game, bongos[data->seq[data->current]][0] / 1920.0, bongos[data->seq[data->current]][1] / 1080.0);
 	}
 
 	ALLEGRO_KEYBOARD_STATE state;
 	al_get_keyboard_state(&state);
 	if (al_key_down(&state, ALLEGRO_KEY_A) && al_key_down(&state, ALLEGRO_KEY_S) && al_key_down(&state, ALLEGRO_KEY_D)) {
-		SwitchCurrentGamestate(game, "taniec");
+		EnterScene(game, "taniec");
 	}
 }
 
@@ -76,7 +66,7 @@ void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
 			(data->user[1] == data->seq[1]) &&
 			(data->user[2] == data->seq[2]) &&
 			(data->user[3] == data->seq[3])) {
-			SwitchCurrentGamestate(game, "taniec");
+			EnterScene(game, "taniec");
 			return;
 		}
 
@@ -85,20 +75,16 @@ void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
 		data->seq[2] = rand() % 5;
 		data->seq[3] = rand() % 5;
 
-		al_stop_sample_instance(data->bongo[data->seq[0]]);
-		al_play_sample_instance(data->bongo[data->seq[0]]);
+		TriggerSample(game, data->bongo[data->seq[0]], 0);
 	}
 	if (data->counter == 70) {
-		al_stop_sample_instance(data->bongo[data->seq[1]]);
-		al_play_sample_instance(data->bongo[data->seq[1]]);
+		TriggerSample(game, data->bongo[data->seq[1]], 0);
 	}
 	if (data->counter == 100) {
-		al_stop_sample_instance(data->bongo[data->seq[2]]);
-		al_play_sample_instance(data->bongo[data->seq[2]]);
+		TriggerSample(game, data->bongo[data->seq[2]], 0);
 	}
 	if (data->counter == 130) {
-		al_stop_sample_instance(data->bongo[data->seq[3]]);
-		al_play_sample_instance(data->bongo[data->seq[3]]);
+		TriggerSample(game, data->bongo[data->seq[3]], 0);
 		ShowMouse(game);
 	}
 	data->counter++;
@@ -123,10 +109,9 @@ void Gamestate_ProcessEvent(struct Game* game, struct GamestateResources* data,
 		if (data->counter < 130) {
 			return;
 		}
-		int b = GetBongo(game, data);
+		int b = GetHotspot(data->mask, game->data->mouseX, game->data->mouseY);
 		if (b >= 0) {
-			al_stop_sample_instance(data->bongo[b]);
-			al_play_sample_instance(data->bongo[b]);
+			TriggerSample(game, data->bongo[b], ev->any.timestamp);
 
 			data->user[data->current] = b;
 			data->current++;
@@ -146,21 +131,24 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->bg = al_load_bitmap(GetDataFilePath(game, "bongo.webp"));
+	data->bg = AcquireBitmap(game, "bongo.webp");
+	progress(game);
+	data->mask = LoadHotspotMask(game, "bongomask.webp", BONGOS, 5);
 	progress(game);
 
 	for (int i = 0; i < 5; i++) {
-		data->sample[i] = al_load_sample(GetDataFilePath(game, PunchNumber(game, "bongoX.flac", 'X', i + 1)));
+		data->sample[i] = AcquireSample(game, PunchNumber(game, "bongoX.flac", 'X', i + 1));
 		data->bongo[i] = al_create_sample_instance(data->sample[i]);
-		al_attach_sample_instance_to_mixer(data->bongo[i], game->audio.fx);
+		al_attach_sample_instance_to_mixer(data->bongo[i], game->data->percussion.mixer);
 		al_set_sample_instance_playmode(data->bongo[i], ALLEGRO_PLAYMODE_ONCE);
 		progress(game);
 	}
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "bongobg.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "bongobg.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
 	al_set_audio_stream_gain(data->music, 0.5);
@@ -172,11 +160,12 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
-	al_destroy_bitmap(data->bg);
+	ReleaseAudioStream(game, data->music);
+	ReleaseBitmap(game, data->bg);
+	DestroyHitMask(data->mask);
 	for (int i = 0; i < 5; i++) {
 		al_destroy_sample_instance(data->bongo[i]);
-		al_destroy_sample(data->sample[i]);
+		ReleaseSample(game, data->sample[i]);
 	}
 	free(data);
 }
@@ -191,6 +180,9 @@ void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
 	data->seq[1] = rand() % 5;
 	data->seq[2] = rand() % 5;
 	data->seq[3] = rand() % 5;
+	for (int i = 0; i < 5; i++) {
+		ArmSample(game, data->bongo[i]);
+	}
 }
 
 void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
@@ -25,7 +25,7 @@ struct GamestateResources {
 	// This struct is for every resource allocated and used by your gamestate.
 	// It gets created on load and then gets passed around to all other function calls.
 	struct Character* but;
-	ALLEGRO_BITMAP* mask;
+	struct HitMask* mask;
 	ALLEGRO_AUDIO_STREAM* music;
 	ALLEGRO_SAMPLE_INSTANCE* sound;
 	ALLEGRO_SAMPLE* sample;
@@ -79,20 +79,21 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->mask = al_load_bitmap(GetDataFilePath(game, "sprites/but/mask.webp"));
+	data->mask = LoadHitMask(game, "sprites/but/mask.webp");
 	progress(game);
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "bongobg.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "bongobg.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
 	al_set_audio_stream_gain(data->music, 0.3);
 	al_attach_audio_stream_to_mixer(data->music, game->audio.music);
 	progress(game);
 
-	data->sample = al_load_sample(GetDataFilePath(game, "but.flac"));
+	data->sample = AcquireSample(game, "but.flac");
 	data->sound = al_create_sample_instance(data->sample);
 	al_attach_sample_instance_to_mixer(data->sound, game->audio.fx);
 	al_set_sample_instance_gain(data->sound, 0.666);
@@ -103,7 +104,7 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	RegisterSpritesheet(game, data->but, "but");
 	RegisterSpritesheet(game, data->but, "standby");
 	RegisterSpritesheet(game, data->but, "blank");
-	LoadSpritesheets(game, data->but, progress);
+	LoadCachedSpritesheets(game, data->but, progress);
 	SelectSpritesheet(game, data->but, "standby");
 
 	return data;
@@ -112,11 +113,11 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
-	DestroyCharacter(game, data->but);
+	ReleaseAudioStream(game, data->music);
+	DestroyCachedCharacter(game, data->but);
 	al_destroy_sample_instance(data->sound);
-	al_destroy_sample(data->sample);
-	al_destroy_bitmap(data->mask);
+	ReleaseSample(game, data->sample);
+	DestroyHitMask(data->mask);
 	free(data);
 }
 
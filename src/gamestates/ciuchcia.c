@@ -29,6 +29,9 @@ struct GamestateResources {
 
 	int state;
 
+	struct SceneCache cache;
+	float x, y, radius; // area covered by the sprite in the previous frame
+
 	int counter;
 };
 
@@ -48,14 +51,25 @@ void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
 
 void Gamestate_Draw(struct Game* game, struct GamestateResources* data) {
 	// Draw everything to the screen here.
-	al_draw_bitmap(data->most, 0, 0, 0);
-
-	al_draw_scaled_rotated_bitmap(data->but,
-		al_get_bitmap_width(data->but) / 2.0, al_get_bitmap_height(data->but) / 2.0,
-		(60 * 5 - data->counter) / (60 * 5.0) * 1920, 1080 / 2.0 - 150,
-		0.3, 0.3, 0.3 + sin(game->time * 10.0) * 0.1, ALLEGRO_FLIP_HORIZONTAL);
-
-	al_draw_bitmap(data->gradient, 0, 0, 0);
+	// only the spot the shoe moves away from and the one it moves to need to be redrawn
+	float x = (60 * 5 - data->counter) / (60 * 5.0) * 1920, y = 1080 / 2.0 - 150;
+	float radius = hypot(al_get_bitmap_width(data->but), al_get_bitmap_height(data->but)) / 2.0 * 0.3;
+	MarkDirty(&data->cache, data->x - data->radius, data->y - data->radius, data->radius * 2, data->radius * 2);
+	MarkDirty(&data->cache, x - radius, y - radius, radius * 2, radius * 2);
+	data->x = x;
+	data->y = y;
+	data->radius = radius;
+
+	if (BeginSceneCache(game, &data->cache)) {
+		al_draw_bitmap(data->most, 0, 0, 0);
+
+		al_draw_scaled_rotated_bitmap(data->but,
+			al_get_bitmap_width(data->but) / 2.0, al_get_bitmap_height(data->but) / 2.0,
+			x, y, 0.3, 0.3, 0.3 + sin(game->time * 10.0) * 0.1, ALLEGRO_FLIP_HORIZONTAL);
+
+		al_draw_bitmap(data->gradient, 0, 0, 0);
+	}
+	EndSceneCache(game, &data->cache);
 }
 
 void Gamestate_ProcessEvent(struct Game* game, struct GamestateResources* data, ALLEGRO_EVENT* ev) {
@@ -74,21 +88,22 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "ciuchcia.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "ciuchcia.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
 	al_set_audio_stream_gain(data->music, 1.5);
 	al_attach_audio_stream_to_mixer(data->music, game->audio.music);
 	progress(game);
 
-	data->most = al_load_bitmap(GetDataFilePath(game, "most.webp"));
+	data->most = AcquireBitmap(game, "most.webp");
 	progress(game);
-	data->but = al_load_bitmap(GetDataFilePath(game, "but_nieanimowany.webp"));
+	data->but = AcquireBitmap(game, "but_nieanimowany.webp");
 	progress(game);
-	data->gradient = al_load_bitmap(GetDataFilePath(game, "gradient.webp"));
+	data->gradient = AcquireBitmap(game, "gradient.webp");
 
 	return data;
 }
@@ -96,10 +111,11 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
-	al_destroy_bitmap(data->most);
-	al_destroy_bitmap(data->but);
-	al_destroy_bitmap(data->gradient);
+	ReleaseAudioStream(game, data->music);
+	ReleaseBitmap(game, data->most);
+	ReleaseBitmap(game, data->but);
+	ReleaseBitmap(game, data->gradient);
+	DestroySceneCache(&data->cache);
 	free(data);
 }
 
@@ -110,6 +126,7 @@ void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
 	al_set_audio_stream_playing(data->music, true);
 	data->counter = 0;
 	data->state = 0;
+	InvalidateSceneCache(&data->cache);
 }
 
 void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
@@ -136,4 +153,5 @@ void Gamestate_Resume(struct Game* game, struct GamestateResources* data) {
 void Gamestate_Reload(struct Game* game, struct GamestateResources* data) {
 	// Called when the display gets lost and not preserved bitmaps need to be recreated.
 	// Unless you want to support mobile platforms, you should be able to ignore it.
+	InvalidateSceneCache(&data->cache);
 }
@@ -24,10 +24,11 @@
 struct GamestateResources {
 	// This struct is for every resource allocated and used by your gamestate.
 	// It gets created on load and then gets passed around to all other function calls.
-	ALLEGRO_BITMAP *domek, *mask;
+	ALLEGRO_BITMAP* domek;
+	struct HitMask* mask;
 	ALLEGRO_SAMPLE_INSTANCE* sound;
 	ALLEGRO_SAMPLE* sample;
-	ALLEGRO_VIDEO* video;
+	struct Video* video;
 	int counter;
 	bool playing;
 	bool released;
@@ -38,7 +39,7 @@ int Gamestate_ProgressCount = 4; // number of loading steps as reported by Games
 void Gamestate_Logic(struct Game* game, struct GamestateResources* data, double delta) {
 	// Here you should do all your game logic as if <delta> seconds have passed.
 	CheckMask(game, data->mask);
-	double pos = al_get_video_position(data->video, ALLEGRO_VIDEO_POSITION_ACTUAL);
+	double pos = GetVideoPosition(data->video);
 	if (pos >= 15 || (data->released && pos >= 4)) {
 		SwitchScene(game, "rave");
 	}
@@ -52,7 +53,7 @@ void Gamestate_Draw(struct Game* game, struct GamestateResources* data) {
 	// Draw everything to the screen here.
 	al_draw_bitmap(data->domek, 0, 0, 0);
 	if (data->playing) {
-		ALLEGRO_BITMAP* bmp = al_get_video_frame(data->video);
+		ALLEGRO_BITMAP* bmp = GetVideoFrame(game, data->video);
 		if (bmp) {
 			al_draw_bitmap(bmp, 0, 0, 0);
 		}
@@ -68,7 +69,7 @@ void Gamestate_ProcessEvent(struct Game* game, struct GamestateResources* data,
 	}
 	if (ev->type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN) {
 		if (!game->data->hover) { return; }
-		al_set_video_playing(data->video, true);
+		PlayVideo(game, data->video, true);
 		data->playing = true;
 		HideMouse(game);
 		al_set_sample_instance_gain(data->sound, 3.0);
@@ -86,21 +87,22 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
-	data->sample = al_load_sample(GetDataFilePath(game, "domek.flac"));
+	data->sample = AcquireSample(game, "domek.flac");
 	data->sound = al_create_sample_instance(data->sample);
 	al_attach_sample_instance_to_mixer(data->sound, game->audio.music);
 	al_set_sample_instance_playmode(data->sound, ALLEGRO_PLAYMODE_LOOP);
 	progress(game);
 
-	data->domek = al_load_bitmap(GetDataFilePath(game, "domek.jpg"));
+	data->domek = AcquireBitmap(game, "domek.jpg");
 	progress(game);
 
-	data->mask = al_load_bitmap(GetDataFilePath(game, "domekmask.webp"));
+	data->mask = LoadHitMask(game, "domekmask.webp");
 	progress(game);
 
-	data->video = al_open_video(GetDataFilePath(game, "domek.ogv"));
+	data->video = OpenVideo(game, "domek.ogv");
 
 	return data;
 }
@@ -108,11 +110,11 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_bitmap(data->domek);
-	al_destroy_bitmap(data->mask);
+	ReleaseBitmap(game, data->domek);
+	DestroyHitMask(data->mask);
 	al_destroy_sample_instance(data->sound);
-	al_destroy_sample(data->sample);
-	al_close_video(data->video);
+	ReleaseSample(game, data->sample);
+	CloseVideo(game, data->video);
 	free(data);
 }
 
@@ -124,14 +126,13 @@ void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
 	data->playing = false;
 	data->released = false;
 	al_play_sample_instance(data->sound);
-	al_start_video(data->video, game->audio.fx);
-	al_set_video_playing(data->video, false);
+	RewindVideo(game, data->video);
 }
 
 void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 	// Called when gamestate gets stopped. Stop timers, music etc. here.
 	al_stop_sample_instance(data->sound);
-	al_set_video_playing(data->video, false);
+	PlayVideo(game, data->video, false);
 }
 
 // Optional endpoints:
@@ -139,6 +140,7 @@ void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 void Gamestate_PostLoad(struct Game* game, struct GamestateResources* data) {
 	// This is called in the main thread after Gamestate_Load has ended.
 	// Use it to prerender bitmaps, create VBOs, etc.
+	PrerollVideo(game, data->video, game->audio.fx);
 }
 
 void Gamestate_Pause(struct Game* game, struct GamestateResources* data) {
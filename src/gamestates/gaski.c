@@ -28,30 +28,45 @@ struct GamestateResources {
 	ALLEGRO_AUDIO_STREAM* music;
 	ALLEGRO_SAMPLE* sample;
 
-	struct Character *gaski[64], *gaska;
+	struct Character* gaska;
+
+	struct {
+		// kept in separate arrays, so the whole crowd can be turned into vertices in one go
+		int count;
+		float *x, *y, *angle, *scale;
+		bool *flip, *reversing;
+		int* sprite;
+		ALLEGRO_VERTEX* vertices;
+	} crowd;
+
+	ALLEGRO_BITMAP* atlas; // both goose sprites side by side, so the crowd needs just one texture
+	struct {
+		int x, width, height;
+	} sprites[2];
 
 	int counter;
 };
 
+static char* GOOSE_SPRITES[2] = {"przod1", "przod2"};
+
 int Gamestate_ProgressCount = 74; // number of loading steps as reported by Gamestate_Load; 0 when missing
 
 void Gamestate_Logic(struct Game* game, struct GamestateResources* data, double delta) {
 	// Here you should do all your game logic as if <delta> seconds have passed.
 	AnimateCharacter(game, data->bg, delta, 1.0);
 
-	for (int i = 0; i < 64; i++) {
-		if (data->gaski[i]->reversing) {
-			MoveCharacter(game, data->gaski[i], -300 * delta, 0, 0);
-		} else {
-			MoveCharacter(game, data->gaski[i], 300 * delta, 0, 0);
-		}
+	for (int i = 0; i < data->crowd.count; i++) {
+		data->crowd.x[i] += (data->crowd.reversing[i] ? -300 : 300) * delta;
 	}
 }
 
 void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
 	// Here you should do all your game logic as if <delta> seconds have passed.
-	data->gaski[rand() % 64]->angle = rand() / (double)RAND_MAX * 0.4 - 0.2;
-	data->gaski[rand() % 64]->angle = rand() / (double)RAND_MAX * 0.3 - 0.15;
+	// keep the same rate of wobbling per goose no matter how big the crowd is
+	for (int i = 0; i < (data->crowd.count + 63) / 64; i++) {
+		data->crowd.angle[rand() % data->crowd.count] = rand() / (double)RAND_MAX * 0.4 - 0.2;
+		data->crowd.angle[rand() % data->crowd.count] = rand() / (double)RAND_MAX * 0.3 - 0.15;
+	}
 	data->counter++;
 
 	if (data->counter == 25) {
@@ -76,9 +91,33 @@ void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
 void Gamestate_Draw(struct Game* game, struct GamestateResources* data) {
 	// Draw everything to the screen here.
 	DrawCharacter(game, data->bg);
-	for (int i = 0; i < 64; i++) {
-		DrawCharacter(game, data->gaski[i]);
+
+	// two triangles per goose, drawn in order so the bigger (closer) ones end up on top
+	ALLEGRO_COLOR white = al_map_rgb(255, 255, 255);
+	for (int i = 0; i < data->crowd.count; i++) {
+		int sprite = data->crowd.sprite[i];
+		float w = data->sprites[sprite].width * data->crowd.scale[i] / 2.0, h = data->sprites[sprite].height * data->crowd.scale[i] / 2.0;
+		float c = cos(data->crowd.angle[i]), s = sin(data->crowd.angle[i]);
+		float u1 = data->sprites[sprite].x, u2 = data->sprites[sprite].x + data->sprites[sprite].width;
+		if (data->crowd.flip[i]) {
+			float tmp = u1;
+			u1 = u2;
+			u2 = tmp;
+		}
+		float corners[4][4] = {{-w, -h, u1, 0}, {w, -h, u2, 0}, {w, h, u2, data->sprites[sprite].height}, {-w, h, u1, data->sprites[sprite].height}};
+		static const int order[6] = {0, 1, 2, 0, 2, 3};
+		for (int j = 0; j < 6; j++) {
+			ALLEGRO_VERTEX* v = &data->crowd.vertices[i * 6 + j];
+			float* corner = corners[order[j]];
+			v->x = data->crowd.x[i] + corner[0] * c - corner[1] * s;
+			v->y = data->crowd.y[i] + corner[0] * s + corner[1] * c;
+			v->z = 0;
+			v->u = corner[2];
+			v->v = corner[3];
+			v->color = white;
+		}
 	}
+	al_draw_prim(data->crowd.vertices, NULL, data->atlas, 0, data->crowd.count * 6, ALLEGRO_PRIM_TRIANGLE_LIST);
 }
 
 void Gamestate_ProcessEvent(struct Game* game, struct GamestateResources* data, ALLEGRO_EVENT* ev) {
@@ -100,6 +139,7 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
@@ -111,56 +151,70 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	RegisterSpritesheet(game, data->gaska, "przod2");
 	RegisterSpritesheet(game, data->gaska, "tyl1");
 	RegisterSpritesheet(game, data->gaska, "tyl2");
-	LoadSpritesheets(game, data->gaska, progress);
+	LoadCachedSpritesheets(game, data->gaska, progress);
 
-	for (int i = 0; i < 64; i++) {
-		data->gaski[i] = CreateCharacter(game, "gaski");
-		data->gaski[i]->shared = true;
-		data->gaski[i]->spritesheets = data->gaska->spritesheets;
+	// the crowd can be made denser for bigger displays; sizes are spread over the same range regardless
+	int count = strtol(GetConfigOptionDefault(game, "odlot", "geese", "64"), NULL, 10);
+	if (count < 2) {
+		count = 2;
+	}
+	data->crowd.count = count;
+	data->crowd.x = calloc(count, sizeof(float));
+	data->crowd.y = calloc(count, sizeof(float));
+	data->crowd.angle = calloc(count, sizeof(float));
+	data->crowd.scale = calloc(count, sizeof(float));
+	data->crowd.flip = calloc(count, sizeof(bool));
+	data->crowd.reversing = calloc(count, sizeof(bool));
+	data->crowd.sprite = calloc(count, sizeof(int));
+	data->crowd.vertices = calloc(count * 6, sizeof(ALLEGRO_VERTEX));
+
+	for (int i = 0; i < count; i++) {
 		bool ktora = rand() % 2;
-		SelectSpritesheet(game, data->gaski[i], ktora ? "przod1" : "przod2");
+		data->crowd.sprite[i] = ktora ? 0 : 1;
 		bool flip = rand() % 2;
-		data->gaski[i]->flipX = flip;
+		data->crowd.flip[i] = flip;
 		double x;
 		if ((ktora && !flip) || (!ktora && flip)) {
 			x = -1920 * (rand() / (double)RAND_MAX) - 1920;
 		} else {
 			x = 1920 * (rand() / (double)RAND_MAX) + 1920 + 1920;
 		}
-		SetCharacterPosition(game, data->gaski[i], x, 1080 * ((rand() / (double)RAND_MAX) / 3.0 + 0.6), 0);
-		data->gaski[i]->reversing = x > 0;
-		data->gaski[i]->scaleX = 0.25 + i * 0.005;
-		data->gaski[i]->scaleY = 0.25 + i * 0.005;
-		progress(game);
+		data->crowd.x[i] = x;
+		data->crowd.y[i] = 1080 * ((rand() / (double)RAND_MAX) / 3.0 + 0.6);
+		data->crowd.reversing[i] = x > 0;
+		data->crowd.scale[i] = 0.25 + i * 0.32 / count;
+		// 64 steps in total, however many geese there are
+		for (int j = i * 64 / count; j < (i + 1) * 64 / count; j++) {
+			progress(game);
+		}
 	}
 
-	SelectSpritesheet(game, data->gaski[0], "przod1");
-	SelectSpritesheet(game, data->gaski[1], "przod2");
-	SetCharacterPosition(game, data->gaski[0], -200, GetCharacterY(game, data->gaski[0]), 0);
-	SetCharacterPosition(game, data->gaski[1], 1920 + 200, GetCharacterY(game, data->gaski[0]), 0);
-	data->gaski[0]->reversing = false;
-	data->gaski[1]->reversing = true;
-	data->gaski[0]->flipX = false;
-	data->gaski[1]->flipX = false;
-	data->gaski[0]->scaleX = 0.25 + 64 * 0.005;
-	data->gaski[0]->scaleY = 0.25 + 64 * 0.005;
-	data->gaski[1]->scaleX = 0.25 + 64 * 0.005;
-	data->gaski[1]->scaleY = 0.25 + 64 * 0.005;
+	data->crowd.sprite[0] = 0;
+	data->crowd.sprite[1] = 1;
+	data->crowd.x[0] = -200;
+	data->crowd.x[1] = 1920 + 200;
+	data->crowd.y[1] = data->crowd.y[0];
+	data->crowd.reversing[0] = false;
+	data->crowd.reversing[1] = true;
+	data->crowd.flip[0] = false;
+	data->crowd.flip[1] = false;
+	data->crowd.scale[0] = 0.25 + 0.32;
+	data->crowd.scale[1] = 0.25 + 0.32;
 	progress(game);
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "niepokoj.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "niepokoj.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
 	al_set_audio_stream_gain(data->music, 0.5);
 	al_attach_audio_stream_to_mixer(data->music, game->audio.music);
 	progress(game);
 
-	data->sample = al_load_sample(GetDataFilePath(game, "gaska.flac"));
+	data->sample = AcquireSample(game, "gaska.flac");
 	progress(game);
 
 	data->bg = CreateCharacter(game, "bgs");
 	RegisterSpritesheet(game, data->bg, "bgs");
-	LoadSpritesheets(game, data->bg, progress);
+	LoadCachedSpritesheets(game, data->bg, progress);
 
 	return data;
 }
@@ -168,15 +222,21 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
-
-	DestroyCharacter(game, data->bg);
-	al_destroy_sample(data->sample);
-
-	for (int i = 0; i < 64; i++) {
-		DestroyCharacter(game, data->gaski[i]);
-	}
-	DestroyCharacter(game, data->gaska);
+	ReleaseAudioStream(game, data->music);
+
+	DestroyCachedCharacter(game, data->bg);
+	ReleaseSample(game, data->sample);
+
+	al_destroy_bitmap(data->atlas);
+	free(data->crowd.x);
+	free(data->crowd.y);
+	free(data->crowd.angle);
+	free(data->crowd.scale);
+	free(data->crowd.flip);
+	free(data->crowd.reversing);
+	free(data->crowd.sprite);
+	free(data->crowd.vertices);
+	DestroyCachedCharacter(game, data->gaska);
 
 	free(data);
 }
@@ -201,6 +261,30 @@ void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 void Gamestate_PostLoad(struct Game* game, struct GamestateResources* data) {
 	// This is called in the main thread after Gamestate_Load has ended.
 	// Use it to prerender bitmaps, create VBOs, etc.
+	int width = 0, height = 0;
+	for (int i = 0; i < 2; i++) {
+		SelectSpritesheet(game, data->gaska, GOOSE_SPRITES[i]);
+		ALLEGRO_BITMAP* bitmap = data->gaska->spritesheet->frames[0].bitmap;
+		data->sprites[i].x = width;
+		data->sprites[i].width = al_get_bitmap_width(bitmap);
+		data->sprites[i].height = al_get_bitmap_height(bitmap);
+		width += data->sprites[i].width + 2; // padding, so filtering doesn't bleed between sprites
+		if (data->sprites[i].height > height) {
+			height = data->sprites[i].height;
+		}
+	}
+
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+	data->atlas = CreateNotPreservedBitmap(width, height);
+	al_set_target_bitmap(data->atlas);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+	for (int i = 0; i < 2; i++) {
+		SelectSpritesheet(game, data->gaska, GOOSE_SPRITES[i]);
+		al_draw_bitmap(data->gaska->spritesheet->frames[0].bitmap, data->sprites[i].x, 0, 0);
+	}
+	al_restore_state(&state);
 }
 
 void Gamestate_Pause(struct Game* game, struct GamestateResources* data) {
@@ -215,4 +299,6 @@ void Gamestate_Resume(struct Game* game, struct GamestateResources* data) {
 void Gamestate_Reload(struct Game* game, struct GamestateResources* data) {
 	// Called when the display gets lost and not preserved bitmaps need to be recreated.
 	// Unless you want to support mobile platforms, you should be able to ignore it.
+	al_destroy_bitmap(data->atlas);
+	Gamestate_PostLoad(game, data);
 }
@@ -26,6 +26,7 @@ struct GamestateResources {
 	// It gets created on load and then gets passed around to all other function calls.
 	struct Character* grzebien;
 	ALLEGRO_AUDIO_STREAM *spada, *rosnie, *odlot, *jeden, *dwa, *trzy;
+	struct AudioClock* clock; // of odlot
 	bool unlocked;
 	int counter;
 	bool odlatuje;
@@ -73,12 +74,8 @@ void Gamestate_Logic(struct Game* game, struct GamestateResources* data, double
 	}
 
 	if (data->odlatuje) {
-		float pos = al_get_audio_stream_position_secs(data->odlot) / al_get_audio_stream_length_secs(data->odlot);
+		float pos = GetAudioClockProgress(game, data->clock);
 		SetCharacterPosition(game, data->grzebien, 1920 * 0.7 - 1920 * (pos - 0.02), 1080 * 1.4 - 800 - 1080 * (pos - 0.02), 0);
-
-		if (pos >= 0.98) {
-			SwitchCurrentGamestate(game, "logo");
-		}
 	}
 
 	if (data->unlocked) {
@@ -109,12 +106,16 @@ void Gamestate_Draw(struct Game* game, struct GamestateResources* data) {
 	DrawCharacter(game, data->grzebien);
 }
 
+static void Odlecial(struct Game* game, void* data) {
+	EnterScene(game, "logo");
+}
+
 static CharacterCallback(Grzebien) {
 	struct GamestateResources* d = data;
 	if (new&& new != old && strcmp(new->name, "grzebien_macha") == 0) {
 		d->odlatuje = true;
-		al_rewind_audio_stream(d->odlot);
-		al_set_audio_stream_playing(d->odlot, true);
+		RewindAudioClock(game, d->clock);
+		PlayAudioClock(game, d->clock, true);
 	}
 }
 
@@ -152,37 +153,38 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->spada = al_load_audio_stream(GetDataFilePath(game, "grzebien.flac"), 4, 2048);
+	data->spada = AcquireAudioStream(game, "grzebien.flac", 4, 2048);
 	al_set_audio_stream_playing(data->spada, false);
 	al_attach_audio_stream_to_mixer(data->spada, game->audio.fx);
 	progress(game);
 
-	data->rosnie = al_load_audio_stream(GetDataFilePath(game, "grzebienrosnie.flac"), 4, 2048);
+	data->rosnie = AcquireAudioStream(game, "grzebienrosnie.flac", 4, 2048);
 	al_set_audio_stream_playing(data->rosnie, false);
 	al_attach_audio_stream_to_mixer(data->rosnie, game->audio.fx);
 	progress(game);
 
-	data->odlot = al_load_audio_stream(GetDataFilePath(game, "grzebienodlot.flac"), 4, 2048);
+	data->odlot = AcquireAudioStream(game, "grzebienodlot.flac", 4, 2048);
 	al_set_audio_stream_playing(data->odlot, false);
 	al_attach_audio_stream_to_mixer(data->odlot, game->audio.fx);
 	progress(game);
 
-	data->jeden = al_load_audio_stream(GetDataFilePath(game, "1.flac"), 4, 2048);
+	data->jeden = AcquireAudioStream(game, "1.flac", 4, 2048);
 	al_set_audio_stream_playing(data->jeden, false);
 	al_set_audio_stream_playmode(data->jeden, ALLEGRO_PLAYMODE_LOOP);
 	al_attach_audio_stream_to_mixer(data->jeden, game->audio.music);
 	progress(game);
 
-	data->dwa = al_load_audio_stream(GetDataFilePath(game, "2.flac"), 4, 2048);
+	data->dwa = AcquireAudioStream(game, "2.flac", 4, 2048);
 	al_set_audio_stream_playing(data->dwa, false);
 	al_set_audio_stream_playmode(data->dwa, ALLEGRO_PLAYMODE_LOOP);
 	al_attach_audio_stream_to_mixer(data->dwa, game->audio.music);
 	progress(game);
 
-	data->trzy = al_load_audio_stream(GetDataFilePath(game, "3.flac"), 4, 2048);
+	data->trzy = AcquireAudioStream(game, "3.flac", 4, 2048);
 	al_set_audio_stream_playing(data->trzy, false);
 	al_set_audio_stream_playmode(data->trzy, ALLEGRO_PLAYMODE_LOOP);
 	al_attach_audio_stream_to_mixer(data->trzy, game->audio.music);
@@ -192,7 +194,7 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	RegisterSpritesheet(game, data->grzebien, "grzebien_rosnie");
 	RegisterSpritesheet(game, data->grzebien, "grzebien_rosnie_skrzydelka");
 	RegisterSpritesheet(game, data->grzebien, "grzebien_macha");
-	LoadSpritesheets(game, data->grzebien, progress);
+	LoadCachedSpritesheets(game, data->grzebien, progress);
 	SelectSpritesheet(game, data->grzebien, "grzebien_rosnie");
 
 	data->circ = CreateShader(game, GetDataFilePath(game, "shaders/vertex.glsl"), GetDataFilePath(game, "shaders/circular_gradient.glsl"));
@@ -206,14 +208,15 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->spada);
-	al_destroy_audio_stream(data->rosnie);
-	al_destroy_audio_stream(data->odlot);
-	al_destroy_audio_stream(data->jeden);
-	al_destroy_audio_stream(data->dwa);
-	al_destroy_audio_stream(data->trzy);
-
-	DestroyCharacter(game, data->grzebien);
+	DestroyAudioClock(game, data->clock);
+	ReleaseAudioStream(game, data->spada);
+	ReleaseAudioStream(game, data->rosnie);
+	ReleaseAudioStream(game, data->odlot);
+	ReleaseAudioStream(game, data->jeden);
+	ReleaseAudioStream(game, data->dwa);
+	ReleaseAudioStream(game, data->trzy);
+
+	DestroyCachedCharacter(game, data->grzebien);
 	DestroyShader(game, data->circ);
 
 	free(data);
@@ -235,7 +238,7 @@ void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 	// Called when gamestate gets stopped. Stop timers, music etc. here.
 	al_set_audio_stream_playing(data->spada, false);
 	al_set_audio_stream_playing(data->rosnie, false);
-	al_set_audio_stream_playing(data->odlot, false);
+	PlayAudioClock(game, data->clock, false);
 }
 
 // Optional endpoints:
@@ -243,6 +246,8 @@ void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 void Gamestate_PostLoad(struct Game* game, struct GamestateResources* data) {
 	// This is called in the main thread after Gamestate_Load has ended.
 	// Use it to prerender bitmaps, create VBOs, etc.
+	data->clock = CreateAudioClock(game, data->odlot, game->audio.fx);
+	AddAudioCue(game, data->clock, 0.98, Odlecial, NULL);
 }
 
 void Gamestate_Pause(struct Game* game, struct GamestateResources* data) {
@@ -27,6 +27,9 @@ struct GamestateResources {
 	ALLEGRO_BITMAP *logo, *chodnik, *gradient, *by;
 	ALLEGRO_AUDIO_STREAM* music;
 
+	struct SceneCache cache;
+	int layers;
+
 	int counter;
 };
 
@@ -48,6 +51,17 @@ void Gamestate_Draw(struct Game* game, struct GamestateResources* data) {
 	// Draw everything to the screen here.
 
 	if (data->counter < 320) {
+		// the picture only changes when one of the layers shows up or goes away
+		int layers = ((data->counter > 60) && (data->counter < 65)) | ((data->counter > 140) && (data->counter < 155)) << 1 | (data->counter > 180) << 2;
+		if (layers != data->layers) {
+			data->layers = layers;
+			InvalidateSceneCache(&data->cache);
+		}
+		if (!BeginSceneCache(game, &data->cache)) {
+			EndSceneCache(game, &data->cache);
+			return;
+		}
+
 		al_draw_bitmap(data->chodnik, 0, 0, 0);
 
 		if ((data->counter > 60) && (data->counter < 65)) {
@@ -68,6 +82,7 @@ void Gamestate_Draw(struct Game* game, struct GamestateResources* data) {
 		}
 
 		al_draw_bitmap(data->gradient, 0, 0, 0);
+		EndSceneCache(game, &data->cache);
 	}
 }
 
@@ -87,19 +102,20 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->chodnik = al_load_bitmap(GetDataFilePath(game, "chodnik.webp"));
+	data->chodnik = AcquireBitmap(game, "chodnik.webp");
 	progress(game);
-	data->gradient = al_load_bitmap(GetDataFilePath(game, "gradient.webp"));
+	data->gradient = AcquireBitmap(game, "gradient.webp");
 	progress(game);
-	data->logo = al_load_bitmap(GetDataFilePath(game, "logo.webp"));
+	data->logo = AcquireBitmap(game, "logo.webp");
 	progress(game);
-	data->by = al_load_bitmap(GetDataFilePath(game, "byholypangolin.webp"));
+	data->by = AcquireBitmap(game, "byholypangolin.webp");
 	progress(game);
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "logo.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "logo.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_attach_audio_stream_to_mixer(data->music, game->audio.music);
 	return data;
@@ -108,11 +124,12 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_bitmap(data->chodnik);
-	al_destroy_bitmap(data->gradient);
-	al_destroy_bitmap(data->logo);
-	al_destroy_bitmap(data->by);
-	al_destroy_audio_stream(data->music);
+	ReleaseBitmap(game, data->chodnik);
+	ReleaseBitmap(game, data->gradient);
+	ReleaseBitmap(game, data->logo);
+	ReleaseBitmap(game, data->by);
+	DestroySceneCache(&data->cache);
+	ReleaseAudioStream(game, data->music);
 	free(data);
 }
 
@@ -121,6 +138,7 @@ void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
 	// playing music etc.
 	al_set_audio_stream_playing(data->music, true);
 	data->counter = 0;
+	InvalidateSceneCache(&data->cache);
 }
 
 void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
@@ -147,4 +165,5 @@ void Gamestate_Resume(struct Game* game, struct GamestateResources* data) {
 void Gamestate_Reload(struct Game* game, struct GamestateResources* data) {
 	// Called when the display gets lost and not preserved bitmaps need to be recreated.
 	// Unless you want to support mobile platforms, you should be able to ignore it.
+	InvalidateSceneCache(&data->cache);
 }
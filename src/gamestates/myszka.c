@@ -30,11 +30,42 @@ enum Myszol {
 	MYSZOL_TOP_RIGHT = 5
 };
 
+#define MYSZKI_COUNT 14
+
+static const struct {
+	enum Myszol myszol;
+	char* file;
+} MYSZKI[MYSZKI_COUNT] = {
+	{MYSZOL_LEFT, "myszki/lewo0.webp"},
+	{MYSZOL_LEFT, "myszki/lewo1.webp"},
+	{MYSZOL_RIGHT, "myszki/prawo0.webp"},
+	{MYSZOL_RIGHT, "myszki/prawo1.webp"},
+	{MYSZOL_RIGHT, "myszki/prawo2.webp"},
+	{MYSZOL_BOTTOM, "myszki/dol0.webp"},
+	{MYSZOL_BOTTOM, "myszki/dol1.webp"},
+	{MYSZOL_BOTTOM, "myszki/dol2.webp"},
+	{MYSZOL_BOTTOM, "myszki/dol3.webp"},
+	{MYSZOL_BOTTOM_LEFT, "myszki/lewodol.webp"},
+	{MYSZOL_TOP, "myszki/gora0.webp"},
+	{MYSZOL_TOP, "myszki/gora1.webp"},
+	{MYSZOL_TOP, "myszki/gora2.webp"},
+	{MYSZOL_TOP_RIGHT, "myszki/prawogora.webp"},
+};
+
 struct GamestateResources {
 	// This struct is for every resource allocated and used by your gamestate.
 	// It gets created on load and then gets passed around to all other function calls.
 	ALLEGRO_BITMAP* myszka;
 	ALLEGRO_AUDIO_STREAM* music;
+	struct AudioClock* clock; // of music
+
+	ALLEGRO_BITMAP* images[MYSZKI_COUNT]; // decoded in memory during Gamestate_Load, packed in Gamestate_PostLoad
+	ALLEGRO_BITMAP* pages[MYSZKI_COUNT]; // atlases; as many as the max texture size demands
+	ALLEGRO_BITMAP* sprites[MYSZKI_COUNT]; // sub-bitmaps of the pages, in MYSZKI order
+	struct {
+		ALLEGRO_BITMAP* sprites[MYSZKI_COUNT];
+		int count;
+	} directions[6];
 
 	enum Myszol myszol;
 	int counter;
@@ -44,7 +75,7 @@ struct GamestateResources {
 	int con;
 };
 
-int Gamestate_ProgressCount = 1; // number of loading steps as reported by Gamestate_Load; 0 when missing
+int Gamestate_ProgressCount = 1 + MYSZKI_COUNT; // number of loading steps as reported by Gamestate_Load; 0 when missing
 
 void Gamestate_Logic(struct Game* game, struct GamestateResources* data, double delta) {
 	// Here you should do all your game logic as if <delta> seconds have passed.
@@ -54,7 +85,11 @@ void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
 	// Here you should do all your game logic as if <delta> seconds have passed.
 	data->counter++;
 	if (data->counter % 6 == 0) {
-		data->pos = al_get_audio_stream_position_secs(data->music) / al_get_audio_stream_length_secs(data->music);
+		double pos = GetAudioClockProgress(game, data->clock); // stays at 1.0 once the music is over
+		// the second half of the run is paced by the prefetch of the upcoming scenes,
+		// so we stretch the transition instead of stalling on a loading screen afterwards
+		pos = fmin(pos, 0.5 + GetPrefetchProgress(game) * 0.5);
+		data->pos = fmin(pos, data->pos + 0.1);
 		data->angle = rand() / (double)RAND_MAX;
 	}
 
@@ -64,7 +99,7 @@ void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
 			if (!game->data->next) {
 				return;
 			}
-			SwitchCurrentGamestate(game, game->data->next);
+			EnterScene(game, game->data->next);
 			free(game->data->next);
 			game->data->next = NULL;
 		}
@@ -120,10 +155,21 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, (rand() % 2) ? "przejscie.flac" : "przejscie2.flac"), 4, 2048);
+	// Decoding happens here rather than when a transition starts; the GPU copies get made in PostLoad.
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+	for (int i = 0; i < MYSZKI_COUNT; i++) {
+		data->images[i] = al_load_bitmap(GetDataFilePath(game, MYSZKI[i].file));
+		progress(game);
+	}
+	al_restore_state(&state);
+
+	data->music = AcquireAudioStream(game, (rand() % 2) ? "przejscie.flac" : "przejscie2.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_attach_audio_stream_to_mixer(data->music, game->audio.music);
 	return data;
@@ -132,8 +178,16 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_bitmap(data->myszka);
-	al_destroy_audio_stream(data->music);
+	for (int i = 0; i < MYSZKI_COUNT; i++) {
+		al_destroy_bitmap(data->images[i]);
+		al_destroy_bitmap(data->sprites[i]);
+	}
+	// sub-bitmaps have to go before their parents
+	for (int i = 0; i < MYSZKI_COUNT; i++) {
+		al_destroy_bitmap(data->pages[i]);
+	}
+	DestroyAudioClock(game, data->clock);
+	ReleaseAudioStream(game, data->music);
 	free(data);
 }
 
@@ -141,39 +195,21 @@ void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
 	// Called when this gamestate gets control. Good place for initializing state,
 	// playing music etc.
 	HideMouse(game);
-	al_set_audio_stream_playing(data->music, true);
+	PlayAudioClock(game, data->clock, true);
 	data->counter = 0;
 	data->con = 0;
+	data->pos = 0;
 
 	data->myszol = rand() % 6;
 
 	data->rand = (rand() / (double)RAND_MAX) * 0.5 - 0.25;
 
-	switch (data->myszol) {
-		case MYSZOL_LEFT:
-			data->myszka = al_load_bitmap(GetDataFilePath(game, PunchNumber(game, "myszki/lewoX.webp", 'X', rand() % 2)));
-			break;
-		case MYSZOL_RIGHT:
-			data->myszka = al_load_bitmap(GetDataFilePath(game, PunchNumber(game, "myszki/prawoX.webp", 'X', rand() % 3)));
-			break;
-		case MYSZOL_TOP:
-			data->myszka = al_load_bitmap(GetDataFilePath(game, PunchNumber(game, "myszki/goraX.webp", 'X', rand() % 3)));
-			break;
-		case MYSZOL_BOTTOM:
-			data->myszka = al_load_bitmap(GetDataFilePath(game, PunchNumber(game, "myszki/dolX.webp", 'X', rand() % 4)));
-			break;
-		case MYSZOL_BOTTOM_LEFT:
-			data->myszka = al_load_bitmap(GetDataFilePath(game, "myszki/lewodol.webp"));
-			break;
-		case MYSZOL_TOP_RIGHT:
-			data->myszka = al_load_bitmap(GetDataFilePath(game, "myszki/prawogora.webp"));
-			break;
-	}
+	data->myszka = data->directions[data->myszol].sprites[rand() % data->directions[data->myszol].count];
 }
 
 void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 	// Called when gamestate gets stopped. Stop timers, music etc. here.
-	al_set_audio_stream_playing(data->music, false);
+	PlayAudioClock(game, data->clock, false);
 }
 
 // Optional endpoints:
@@ -181,6 +217,72 @@ void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 void Gamestate_PostLoad(struct Game* game, struct GamestateResources* data) {
 	// This is called in the main thread after Gamestate_Load has ended.
 	// Use it to prerender bitmaps, create VBOs, etc.
+	data->clock = CreateAudioClock(game, data->music, game->audio.music);
+
+	// Shelf-pack the sprites, tallest first, into as few pages as the max texture size allows.
+	int order[MYSZKI_COUNT];
+	for (int i = 0; i < MYSZKI_COUNT; i++) {
+		order[i] = i;
+		for (int j = i; j > 0 && al_get_bitmap_height(data->images[order[j]]) > al_get_bitmap_height(data->images[order[j - 1]]); j--) {
+			int tmp = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = tmp;
+		}
+	}
+
+	int max = al_get_display_option(game->display, ALLEGRO_MAX_BITMAP_SIZE);
+	if (max <= 0 || max > 4096) {
+		max = 4096;
+	}
+	int page[MYSZKI_COUNT], x[MYSZKI_COUNT], y[MYSZKI_COUNT];
+	int widths[MYSZKI_COUNT] = {0}, heights[MYSZKI_COUNT] = {0};
+	int pages = 0, shelf = 0, shelfx = 0, shelfy = 0;
+	for (int i = 0; i < MYSZKI_COUNT; i++) {
+		ALLEGRO_BITMAP* image = data->images[order[i]];
+		int w = al_get_bitmap_width(image) + 2, h = al_get_bitmap_height(image) + 2; // padding, so filtering doesn't bleed between sprites
+		if (!pages || shelfx + w > max) {
+			// new shelf
+			shelfy += shelf;
+			shelfx = 0;
+			shelf = h;
+			if (!pages || shelfy + h > max) {
+				pages++;
+				shelfy = 0;
+			}
+		}
+		page[order[i]] = pages - 1;
+		x[order[i]] = shelfx + 1;
+		y[order[i]] = shelfy + 1;
+		shelfx += w;
+		if (shelfx > widths[pages - 1]) {
+			widths[pages - 1] = shelfx;
+		}
+		if (shelfy + h > heights[pages - 1]) {
+			heights[pages - 1] = shelfy + h;
+		}
+	}
+
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+	for (int i = 0; i < pages; i++) {
+		data->pages[i] = al_create_bitmap(widths[i], heights[i]);
+		al_set_target_bitmap(data->pages[i]);
+		al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	}
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+	for (int i = 0; i < MYSZKI_COUNT; i++) {
+		ALLEGRO_BITMAP* image = data->images[i];
+		int w = al_get_bitmap_width(image), h = al_get_bitmap_height(image);
+		al_set_target_bitmap(data->pages[page[i]]);
+		al_draw_bitmap(image, x[i], y[i], 0);
+		al_destroy_bitmap(image);
+		data->images[i] = NULL;
+
+		data->sprites[i] = al_create_sub_bitmap(data->pages[page[i]], x[i], y[i], w, h);
+		data->directions[MYSZKI[i].myszol].sprites[data->directions[MYSZKI[i].myszol].count++] = data->sprites[i];
+	}
+	al_restore_state(&state);
+	PrintConsole(game, "Packed %d mice into %d atlas page(s)", MYSZKI_COUNT, pages);
 }
 
 void Gamestate_Pause(struct Game* game, struct GamestateResources* data) {
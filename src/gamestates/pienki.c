@@ -25,6 +25,7 @@ struct GamestateResources {
 	// This struct is for every resource allocated and used by your gamestate.
 	// It gets created on load and then gets passed around to all other function calls.
 	struct Character *pienki, *mask;
+	struct HitMask** masks;
 	ALLEGRO_AUDIO_STREAM* music;
 
 	ALLEGRO_SAMPLE* sample;
@@ -40,7 +41,7 @@ int Gamestate_ProgressCount = 5; // number of loading steps as reported by Games
 void Gamestate_Logic(struct Game* game, struct GamestateResources* data, double delta) {
 	// Here you should do all your game logic as if <delta> seconds have passed.
 	//AnimateCharacter(game, data->pienki, delta, 1.0);
-	CheckMask(game, data->mask->frame->bitmap);
+	CheckMask(game, data->masks[data->mask->pos]);
 }
 
 void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
@@ -67,7 +68,7 @@ void Gamestate_ProcessEvent(struct Game* game, struct GamestateResources* data,
 		al_stop_sample_instance(data->pac);
 		al_play_sample_instance(data->pac);
 		if (data->counter == 5) {
-			SwitchCurrentGamestate(game, "altanka");
+			EnterScene(game, "altanka");
 		}
 	}
 }
@@ -79,17 +80,18 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "pienki.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "pienki.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
 	al_set_audio_stream_gain(data->music, 1.0);
 	al_attach_audio_stream_to_mixer(data->music, game->audio.music);
 	progress(game);
 
-	data->sample = al_load_sample(GetDataFilePath(game, "pac.flac"));
+	data->sample = AcquireSample(game, "pac.flac");
 	data->pac = al_create_sample_instance(data->sample);
 	al_attach_sample_instance_to_mixer(data->pac, game->audio.fx);
 	al_set_sample_instance_gain(data->pac, 0.5);
@@ -98,11 +100,15 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 
 	data->pienki = CreateCharacter(game, "pienki");
 	RegisterSpritesheet(game, data->pienki, "pienki_myszka");
-	LoadSpritesheets(game, data->pienki, progress);
+	LoadCachedSpritesheets(game, data->pienki, progress);
 
 	data->mask = CreateCharacter(game, "pienki");
 	RegisterSpritesheet(game, data->mask, "mask");
-	LoadSpritesheets(game, data->mask, progress);
+	LoadCachedSpritesheets(game, data->mask, progress);
+	data->masks = calloc(data->mask->spritesheets->frameCount, sizeof(struct HitMask*));
+	for (int i = 0; i < data->mask->spritesheets->frameCount; i++) {
+		data->masks[i] = CreateHitMask(data->mask->spritesheets->frames[i].bitmap);
+	}
 
 	return data;
 }
@@ -110,11 +116,15 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
-	DestroyCharacter(game, data->pienki);
-	DestroyCharacter(game, data->mask);
+	ReleaseAudioStream(game, data->music);
+	DestroyCachedCharacter(game, data->pienki);
+	for (int i = 0; i < data->mask->spritesheets->frameCount; i++) {
+		DestroyHitMask(data->masks[i]);
+	}
+	free(data->masks);
+	DestroyCachedCharacter(game, data->mask);
 	al_destroy_sample_instance(data->pac);
-	al_destroy_sample(data->sample);
+	ReleaseSample(game, data->sample);
 	free(data);
 }
 
@@ -25,7 +25,7 @@ struct GamestateResources {
 	// This struct is for every resource allocated and used by your gamestate.
 	// It gets created on load and then gets passed around to all other function calls.
 	struct Character* pudelko;
-	ALLEGRO_BITMAP* mask;
+	struct HitMask* mask;
 	ALLEGRO_AUDIO_STREAM* music;
 	ALLEGRO_SAMPLE_INSTANCE* sound[3];
 	ALLEGRO_SAMPLE* sample[3];
@@ -52,7 +52,7 @@ void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
 	if (data->state >= 3) {
 		data->counter++;
 		if (data->counter == 60 * 2) {
-			SwitchCurrentGamestate(game, "pienki");
+			EnterScene(game, "pienki");
 		}
 	}
 }
@@ -99,10 +99,11 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "bongobg.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "bongobg.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
 	al_set_audio_stream_gain(data->music, 0.5);
@@ -110,7 +111,7 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	progress(game);
 
 	for (int i = 0; i < 3; i++) {
-		data->sample[i] = al_load_sample(GetDataFilePath(game, PunchNumber(game, "pudelkoX.flac", 'X', i + 1)));
+		data->sample[i] = AcquireSample(game, PunchNumber(game, "pudelkoX.flac", 'X', i + 1));
 		data->sound[i] = al_create_sample_instance(data->sample[i]);
 		al_attach_sample_instance_to_mixer(data->sound[i], game->audio.fx);
 		al_set_sample_instance_playmode(data->sound[i], ALLEGRO_PLAYMODE_ONCE);
@@ -122,25 +123,25 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	RegisterSpritesheet(game, data->pudelko, "pudelko1");
 	RegisterSpritesheet(game, data->pudelko, "pudelko2");
 	RegisterSpritesheet(game, data->pudelko, "pudelko3");
-	LoadSpritesheets(game, data->pudelko, progress);
+	LoadCachedSpritesheets(game, data->pudelko, progress);
 	SelectSpritesheet(game, data->pudelko, "pudelko");
 	progress(game);
 
-	data->mask = al_load_bitmap(GetDataFilePath(game, "sprites/pudelko/mask.webp"));
+	data->mask = LoadHitMask(game, "sprites/pudelko/mask.webp");
 	return data;
 }
 
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
+	ReleaseAudioStream(game, data->music);
 
-	DestroyCharacter(game, data->pudelko);
+	DestroyCachedCharacter(game, data->pudelko);
 	for (int i = 0; i < 3; i++) {
 		al_destroy_sample_instance(data->sound[i]);
-		al_destroy_sample(data->sample[i]);
+		ReleaseSample(game, data->sample[i]);
 	}
-	al_destroy_bitmap(data->mask);
+	DestroyHitMask(data->mask);
 	free(data);
 }
 
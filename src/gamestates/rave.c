@@ -25,7 +25,7 @@ struct GamestateResources {
 	// This struct is for every resource allocated and used by your gamestate.
 	// It gets created on load and then gets passed around to all other function calls.
 	struct Character* rave;
-	ALLEGRO_BITMAP* mask;
+	struct HitMask* mask;
 	ALLEGRO_AUDIO_STREAM* music;
 	ALLEGRO_SAMPLE_INSTANCE* sound;
 	ALLEGRO_SAMPLE* sample;
@@ -85,17 +85,18 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "rave.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "rave.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
 	al_set_audio_stream_gain(data->music, 1.5);
 	al_attach_audio_stream_to_mixer(data->music, game->audio.music);
 	progress(game);
 
-	data->sample = al_load_sample(GetDataFilePath(game, "silence.flac"));
+	data->sample = AcquireSample(game, "silence.flac");
 	data->sound = al_create_sample_instance(data->sample);
 	al_attach_sample_instance_to_mixer(data->sound, game->audio.music);
 	al_set_sample_instance_playmode(data->sound, ALLEGRO_PLAYMODE_LOOP);
@@ -103,10 +104,10 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 
 	data->rave = CreateCharacter(game, "rave");
 	RegisterSpritesheet(game, data->rave, "niebieski_z_tlem");
-	LoadSpritesheets(game, data->rave, progress);
+	LoadCachedSpritesheets(game, data->rave, progress);
 	progress(game);
 
-	data->mask = al_load_bitmap(GetDataFilePath(game, "sprites/rave/mask.webp"));
+	data->mask = LoadHitMask(game, "sprites/rave/mask.webp");
 
 	return data;
 }
@@ -114,11 +115,11 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
-	DestroyCharacter(game, data->rave);
+	ReleaseAudioStream(game, data->music);
+	DestroyCachedCharacter(game, data->rave);
 	al_destroy_sample_instance(data->sound);
-	al_destroy_sample(data->sample);
-	al_destroy_bitmap(data->mask);
+	ReleaseSample(game, data->sample);
+	DestroyHitMask(data->mask);
 	free(data);
 }
 
@@ -25,12 +25,13 @@ struct GamestateResources {
 	// This struct is for every resource allocated and used by your gamestate.
 	// It gets created on load and then gets passed around to all other function calls.
 	struct Character* rzeczka;
-	ALLEGRO_BITMAP* mask;
+	struct HitMask* mask;
 	ALLEGRO_AUDIO_STREAM* music;
 	ALLEGRO_SAMPLE_INSTANCE* sound;
 	ALLEGRO_SAMPLE* sample;
 	ALLEGRO_BITMAP* myszka;
 	ALLEGRO_FONT* font;
+	struct TextLayer text;
 
 	int state;
 
@@ -91,25 +92,26 @@ void Gamestate_Draw(struct Game* game, struct GamestateResources* data) {
 
 	int padding = 48;
 
+	// the text only changes a few times, so it gets laid out once per change
 	if (data->counter > 19 * 60) {
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding, ALLEGRO_ALIGN_LEFT, "The game has been created at the Geek Jam");
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding + padding, ALLEGRO_ALIGN_LEFT, "during the Game Industry Conference 2018.");
+		const char* lines[] = {"The game has been created at the Geek Jam", "during the Game Industry Conference 2018."};
+		SetTextLayer(game, &data->text, data->font, padding, lines, 2);
 	} else if (data->counter > 15 * 60) {
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding, ALLEGRO_ALIGN_LEFT, "Physical assets:");
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding + padding, ALLEGRO_ALIGN_LEFT, "Fundacja Pogotowie Społeczne");
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding + padding + padding, ALLEGRO_ALIGN_LEFT, "Handmade during a set of workshops for the socially excluded.");
+		const char* lines[] = {"Physical assets:", "Fundacja Pogotowie Społeczne", "Handmade during a set of workshops for the socially excluded."};
+		SetTextLayer(game, &data->text, data->font, padding, lines, 3);
 	} else if (data->counter > 12 * 60) {
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding, ALLEGRO_ALIGN_LEFT, "Sound samples:");
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding + padding, ALLEGRO_ALIGN_LEFT, "Polish Radio Experimental Studio");
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding + padding + padding, ALLEGRO_ALIGN_LEFT, "(published by Adam Mickiewicz Institute)");
+		const char* lines[] = {"Sound samples:", "Polish Radio Experimental Studio", "(published by Adam Mickiewicz Institute)"};
+		SetTextLayer(game, &data->text, data->font, padding, lines, 3);
 	} else if (data->counter > 9 * 60) {
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding, ALLEGRO_ALIGN_LEFT, "Made with libsuperderpy engine");
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding + padding, ALLEGRO_ALIGN_LEFT, "and Allegro 5 library.");
+		const char* lines[] = {"Made with libsuperderpy engine", "and Allegro 5 library."};
+		SetTextLayer(game, &data->text, data->font, padding, lines, 2);
 	} else if (data->counter > 6 * 60) {
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding, ALLEGRO_ALIGN_LEFT, "by Holy Pangolin");
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding + padding + padding, ALLEGRO_ALIGN_LEFT, "Agata Nawrot");
-		al_draw_text(data->font, al_map_rgb(255, 255, 255), padding, padding + padding + padding + padding, ALLEGRO_ALIGN_LEFT, "Sebastian Krzyszkowiak");
+		const char* lines[] = {"by Holy Pangolin", NULL, "Agata Nawrot", "Sebastian Krzyszkowiak"};
+		SetTextLayer(game, &data->text, data->font, padding, lines, 4);
+	} else {
+		return;
 	}
+	DrawTextLayer(game, &data->text, al_map_rgb(255, 255, 255), padding, padding);
 }
 
 void Gamestate_ProcessEvent(struct Game* game, struct GamestateResources* data, ALLEGRO_EVENT* ev) {
@@ -135,21 +137,22 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
-	data->myszka = al_load_bitmap(GetDataFilePath(game, "myszki/prawo2.webp"));
+	data->myszka = AcquireBitmap(game, "myszki/prawo2.webp");
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->font = al_load_font(GetDataFilePath(game, "fonts/DejaVuSansMono.ttf"), 42, 0);
+	data->font = AcquireFont(game, "fonts/DejaVuSansMono.ttf", 42);
 	progress(game);
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "rzeczka.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "rzeczka.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
 	al_set_audio_stream_gain(data->music, 0.9);
 	al_attach_audio_stream_to_mixer(data->music, game->audio.music);
 	progress(game);
 
-	data->sample = al_load_sample(GetDataFilePath(game, "odlot.flac"));
+	data->sample = AcquireSample(game, "odlot.flac");
 	data->sound = al_create_sample_instance(data->sample);
 	al_attach_sample_instance_to_mixer(data->sound, game->audio.music);
 	al_set_sample_instance_playmode(data->sound, ALLEGRO_PLAYMODE_LOOP);
@@ -157,11 +160,11 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 
 	data->rzeczka = CreateCharacter(game, "rzeczka");
 	RegisterSpritesheet(game, data->rzeczka, "animacja_rzeka");
-	LoadSpritesheets(game, data->rzeczka, progress);
+	LoadCachedSpritesheets(game, data->rzeczka, progress);
 	SelectSpritesheet(game, data->rzeczka, "-animacja_rzeka");
 	progress(game);
 
-	data->mask = al_load_bitmap(GetDataFilePath(game, "sprites/rzeczka/mask.webp"));
+	data->mask = LoadHitMask(game, "sprites/rzeczka/mask.webp");
 
 	return data;
 }
@@ -169,12 +172,14 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
-	DestroyCharacter(game, data->rzeczka);
+	ReleaseAudioStream(game, data->music);
+	DestroyCachedCharacter(game, data->rzeczka);
 	al_destroy_sample_instance(data->sound);
-	al_destroy_sample(data->sample);
-	al_destroy_bitmap(data->mask);
-	al_destroy_bitmap(data->myszka);
+	ReleaseSample(game, data->sample);
+	DestroyHitMask(data->mask);
+	ReleaseBitmap(game, data->myszka);
+	ReleaseFont(game, data->font);
+	DestroyTextLayer(&data->text);
 	free(data);
 }
 
@@ -215,4 +220,5 @@ void Gamestate_Resume(struct Game* game, struct GamestateResources* data) {
 void Gamestate_Reload(struct Game* game, struct GamestateResources* data) {
 	// Called when the display gets lost and not preserved bitmaps need to be recreated.
 	// Unless you want to support mobile platforms, you should be able to ignore it.
+	ClearTextLayer(&data->text);
 }
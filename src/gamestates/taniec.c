@@ -27,6 +27,7 @@ struct GamestateResources {
 	ALLEGRO_BITMAP *bg, *gradient;
 	ALLEGRO_AUDIO_STREAM* music;
 	ALLEGRO_AUDIO_STREAM* taniec;
+	struct AudioClock* clock; // of taniec
 
 	struct Character *niebieski, *sowka, *grzebien;
 	int counter;
@@ -42,17 +43,13 @@ void Gamestate_Logic(struct Game* game, struct GamestateResources* data, double
 
 	data->grzebien->scaleX = 0.333;
 	data->grzebien->scaleY = 0.333;
-	float pos = al_get_audio_stream_position_secs(data->taniec) / al_get_audio_stream_length_secs(data->taniec);
+	float pos = GetAudioClockProgress(game, data->clock);
 	SetCharacterPosition(game, data->grzebien, 1920 * 2 * (1.0 - pos) - 1920 / 2.0, 1080 * 0.4 + sin(game->time * 3.0) * 40, 0);
 }
 
 void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
 	// Here you should do all your game logic as if <delta> seconds have passed.
 	data->counter++;
-	float pos = al_get_audio_stream_position_secs(data->taniec) / al_get_audio_stream_length_secs(data->taniec);
-	if (pos >= 1.0) {
-		SwitchScene(game, "domek");
-	}
 	if (data->counter % 20 == 0) {
 		SetCharacterPosition(game, data->niebieski, rand() / (double)RAND_MAX * 1920, rand() / (double)RAND_MAX * 1080, rand());
 		data->niebieski->scaleX = (0.5 + rand() / (double)RAND_MAX) / 3.0;
@@ -65,6 +62,10 @@ void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
 	}
 }
 
+static void TaniecEnded(struct Game* game, void* data) {
+	SwitchScene(game, "domek");
+}
+
 void Gamestate_Draw(struct Game* game, struct GamestateResources* data) {
 	// Draw everything to the screen here.
 	al_draw_bitmap(data->bg, 0, 0, 0);
@@ -90,22 +91,23 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->bg = al_load_bitmap(GetDataFilePath(game, "bongo.webp"));
+	data->bg = AcquireBitmap(game, "bongo.webp");
 	progress(game);
-	data->gradient = al_load_bitmap(GetDataFilePath(game, "gradient.webp"));
+	data->gradient = AcquireBitmap(game, "gradient.webp");
 	progress(game);
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "bongobg.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "bongobg.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
 	al_set_audio_stream_gain(data->music, 1.0);
 	al_attach_audio_stream_to_mixer(data->music, game->audio.music);
 	progress(game);
 
-	data->taniec = al_load_audio_stream(GetDataFilePath(game, "taniec.flac"), 4, 2048);
+	data->taniec = AcquireAudioStream(game, "taniec.flac", 4, 2048);
 	al_set_audio_stream_playing(data->taniec, false);
 	al_set_audio_stream_playmode(data->taniec, ALLEGRO_PLAYMODE_ONCE);
 	al_attach_audio_stream_to_mixer(data->taniec, game->audio.music);
@@ -114,16 +116,16 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	data->niebieski = CreateCharacter(game, "niebieski");
 	RegisterSpritesheet(game, data->niebieski, "niebieski_przod");
 	RegisterSpritesheet(game, data->niebieski, "niebieski_tyl");
-	LoadSpritesheets(game, data->niebieski, progress);
+	LoadCachedSpritesheets(game, data->niebieski, progress);
 
 	data->sowka = CreateCharacter(game, "sowka");
 	RegisterSpritesheet(game, data->sowka, "sowka_przod");
 	RegisterSpritesheet(game, data->sowka, "sowka_tyl");
-	LoadSpritesheets(game, data->sowka, progress);
+	LoadCachedSpritesheets(game, data->sowka, progress);
 
 	data->grzebien = CreateCharacter(game, "grzebien");
 	RegisterSpritesheet(game, data->grzebien, "grzebien_macha");
-	LoadSpritesheets(game, data->grzebien, progress);
+	LoadCachedSpritesheets(game, data->grzebien, progress);
 
 	return data;
 }
@@ -131,13 +133,14 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
-	al_destroy_audio_stream(data->taniec);
-	al_destroy_bitmap(data->bg);
-	al_destroy_bitmap(data->gradient);
-	DestroyCharacter(game, data->niebieski);
-	DestroyCharacter(game, data->sowka);
-	DestroyCharacter(game, data->grzebien);
+	DestroyAudioClock(game, data->clock);
+	ReleaseAudioStream(game, data->music);
+	ReleaseAudioStream(game, data->taniec);
+	ReleaseBitmap(game, data->bg);
+	ReleaseBitmap(game, data->gradient);
+	DestroyCachedCharacter(game, data->niebieski);
+	DestroyCachedCharacter(game, data->sowka);
+	DestroyCachedCharacter(game, data->grzebien);
 
 	free(data);
 }
@@ -147,14 +150,14 @@ void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
 	// playing music etc.
 	HideMouse(game);
 	al_set_audio_stream_playing(data->music, true);
-	al_set_audio_stream_playing(data->taniec, true);
+	PlayAudioClock(game, data->clock, true);
 	data->counter = 0;
 }
 
 void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 	// Called when gamestate gets stopped. Stop timers, music etc. here.
 	al_set_audio_stream_playing(data->music, false);
-	al_set_audio_stream_playing(data->taniec, false);
+	PlayAudioClock(game, data->clock, false);
 }
 
 // Optional endpoints:
@@ -162,6 +165,8 @@ void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 void Gamestate_PostLoad(struct Game* game, struct GamestateResources* data) {
 	// This is called in the main thread after Gamestate_Load has ended.
 	// Use it to prerender bitmaps, create VBOs, etc.
+	data->clock = CreateAudioClock(game, data->taniec, game->audio.music);
+	AddAudioCue(game, data->clock, 1.0, TaniecEnded, NULL);
 }
 
 void Gamestate_Pause(struct Game* game, struct GamestateResources* data) {
@@ -29,7 +29,7 @@ struct GamestateResources {
 	ALLEGRO_SAMPLE* sample;
 	ALLEGRO_SAMPLE_INSTANCE* pac;
 
-	ALLEGRO_VIDEO* video;
+	struct Video* video;
 
 	int state;
 
@@ -56,8 +56,9 @@ void Gamestate_Tick(struct Game* game, struct GamestateResources* data) {
 
 void Gamestate_Draw(struct Game* game, struct GamestateResources* data) {
 	// Draw everything to the screen here.
-	if (al_get_video_frame(data->video)) {
-		al_draw_bitmap(al_get_video_frame(data->video), 0, 0, 0);
+	ALLEGRO_BITMAP* frame = GetVideoFrame(game, data->video);
+	if (frame) {
+		al_draw_bitmap(frame, 0, 0, 0);
 	}
 }
 
@@ -79,24 +80,25 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
+	UseAssetPack(game); // the loading thread looks data files up in the pack from now on
 	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "wrona.flac"), 4, 2048);
+	data->music = AcquireAudioStream(game, "wrona.flac", 4, 2048);
 	al_set_audio_stream_playing(data->music, false);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
 	al_set_audio_stream_gain(data->music, 1.0);
 	al_attach_audio_stream_to_mixer(data->music, game->audio.music);
 	progress(game);
 
-	data->sample = al_load_sample(GetDataFilePath(game, "alarm.flac"));
+	data->sample = AcquireSample(game, "alarm.flac");
 	data->pac = al_create_sample_instance(data->sample);
 	al_attach_sample_instance_to_mixer(data->pac, game->audio.fx);
 	al_set_sample_instance_gain(data->pac, 1.0);
 	al_set_sample_instance_playmode(data->pac, ALLEGRO_PLAYMODE_ONCE);
 	progress(game);
 
-	data->video = al_open_video(GetDataFilePath(game, "wrona.ogv"));
+	data->video = OpenVideo(game, "wrona.ogv");
 
 	return data;
 }
@@ -104,10 +106,10 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
-	al_close_video(data->video);
+	ReleaseAudioStream(game, data->music);
+	CloseVideo(game, data->video);
 	al_destroy_sample_instance(data->pac);
-	al_destroy_sample(data->sample);
+	ReleaseSample(game, data->sample);
 	free(data);
 }
 
@@ -118,13 +120,14 @@ void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
 	al_set_audio_stream_playing(data->music, true);
 	data->counter = 0;
 	data->state = 0;
-	al_start_video(data->video, game->audio.fx);
+	RewindVideo(game, data->video);
+	PlayVideo(game, data->video, true);
 }
 
 void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 	// Called when gamestate gets stopped. Stop timers, music etc. here.
 	al_set_audio_stream_playing(data->music, false);
-	al_set_video_playing(data->video, false);
+	PlayVideo(game, data->video, false);
 }
 
 // Optional endpoints:
@@ -132,6 +135,7 @@ void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 void Gamestate_PostLoad(struct Game* game, struct GamestateResources* data) {
 	// This is called in the main thread after Gamestate_Load has ended.
 	// Use it to prerender bitmaps, create VBOs, etc.
+	PrerollVideo(game, data->video, game->audio.fx);
 }
 
 void Gamestate_Pause(struct Game* game, struct GamestateResources* data) {
@@ -23,6 +23,7 @@
 #include <libsuperderpy.h>
 #include <signal.h>
 #include <stdio.h>
+#include <string.h>
 
 static _Noreturn void derp(int sig) {
 	ssize_t __attribute__((unused)) n = write(STDERR_FILENO, "Segmentation fault\nI just don't know what went wrong!\n", 54);
@@ -32,7 +33,19 @@ static _Noreturn void derp(int sig) {
 int main(int argc, char** argv) {
 	signal(SIGSEGV, derp);
 
-	srand(time(NULL));
+	char* benchmark = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--benchmark", 11) == 0 && (argv[i][11] == '\0' || argv[i][11] == '=')) {
+			benchmark = argv[i][11] ? argv[i] + 12 : "benchmark.json";
+			// hide it from libsuperderpy
+			argc--;
+			memmove(&argv[i], &argv[i + 1], (argc - i + 1) * sizeof(char*));
+			i--;
+		}
+	}
+
+	// benchmark runs have to be reproducible
+	srand(benchmark ? 1 : time(NULL));
 
 	al_set_org_name("Holy Pangolin");
 	al_set_app_name(LIBSUPERDERPY_GAMENAME_PRETTY);
@@ -41,31 +54,22 @@ int main(int argc, char** argv) {
 	if (!game) { return 1; }
 	al_set_window_title(game->display, LIBSUPERDERPY_GAMENAME_PRETTY);
 
-	LoadGamestate(game, "myszka");
+	game->data = CreateGameData(game);
+	if (benchmark) {
+		StartBenchmark(game, benchmark);
+	}
 
-	LoadGamestate(game, "altanka");
-	LoadGamestate(game, "bongo");
-	LoadGamestate(game, "but");
-	LoadGamestate(game, "ciuchcia");
-	LoadGamestate(game, "domek");
-	LoadGamestate(game, "gaski");
-	LoadGamestate(game, "intro");
-	LoadGamestate(game, "logo");
-	LoadGamestate(game, "pienki");
-	LoadGamestate(game, "pudelko");
-	LoadGamestate(game, "rave");
-	LoadGamestate(game, "rzeczka");
-	LoadGamestate(game, "taniec");
-	LoadGamestate(game, "wrona");
+	LoadGamestate(game, "myszka");
+	UpdateResidency(game, "intro");
 
 	StartGamestate(game, "intro");
 
-	game->data = CreateGameData(game);
-
 	game->show_loading_on_launch = true;
 	game->handlers.event = GlobalEventHandler;
 	game->handlers.destroy = DestroyGameData;
 	game->handlers.prelogic = PreLogic;
+	game->handlers.postlogic = PostLogic;
+	game->handlers.predraw = PreDraw;
 
 	EnableCompositor(game, Compositor);
 
@@ -0,0 +1,518 @@
+/*! \file pack.c
+ *  \brief Game data read from a single memory mapped pack.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+// Allegro's file interface doesn't pass any user data on open, so the pack in use lives here.
+static struct AssetPack* pack = NULL;
+static const ALLEGRO_FILE_INTERFACE* pack_fallback = NULL;
+static const ALLEGRO_FS_INTERFACE* pack_fs_fallback = NULL;
+static const ALLEGRO_FS_INTERFACE pack_fs_interface;
+
+struct PackFile {
+	const struct PackEntry* entry; // NULL for files that aren't in the pack
+	ALLEGRO_FILE* fallback;
+	int64_t position;
+	bool eof;
+};
+
+static int ComparePackEntries(const void* a, const void* b) {
+	return strcmp(((const struct PackEntry*)a)->path, ((const struct PackEntry*)b)->path);
+}
+
+// Turns an absolute path into one relative to the pack, or returns false if it's outside.
+static bool GetPackPath(const char* path, char* relative, size_t size) {
+	if (!pack) {
+		return false;
+	}
+	size_t len = strlen(pack->root);
+	if (strncmp(path, pack->root, len) != 0) {
+		return false;
+	}
+	snprintf(relative, size, "%s", path + len);
+	for (char* c = relative; *c; c++) {
+		if (*c == '\\') {
+			*c = '/';
+		}
+	}
+	return true;
+}
+
+static const struct PackEntry* FindPackEntry(const char* path) {
+	char relative[255];
+	if (!GetPackPath(path, relative, sizeof(relative))) {
+		return NULL;
+	}
+	struct PackEntry key = {.path = relative};
+	return bsearch(&key, pack->entries, pack->count, sizeof(struct PackEntry), ComparePackEntries);
+}
+
+// Directories aren't stored, but entries are sorted, so the first one that doesn't sort before
+// "<dir>/" tells whether there's anything inside.
+static bool IsPackDirectory(const char* path) {
+	char relative[255];
+	if (!GetPackPath(path, relative, sizeof(relative))) {
+		return false;
+	}
+	size_t len = strlen(relative);
+	if (len && relative[len - 1] != '/') {
+		strncat(relative, "/", sizeof(relative) - len - 1);
+		len++;
+	}
+	int low = 0, high = pack->count;
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (strcmp(pack->entries[mid].path, relative) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low < pack->count && strncmp(pack->entries[low].path, relative, len) == 0;
+}
+
+// Returns the contents of given file straight from the mapping, or NULL if it isn't packed.
+const unsigned char* GetPackedFile(const char* path, int64_t* size) {
+	const struct PackEntry* entry = FindPackEntry(path);
+	if (!entry) {
+		return NULL;
+	}
+	*size = entry->size;
+	return entry->data;
+}
+
+static void* PackOpen(const char* path, const char* mode) {
+	struct PackFile* file = calloc(1, sizeof(struct PackFile));
+	if (!strpbrk(mode, "wa+")) {
+		file->entry = FindPackEntry(path);
+	}
+	if (!file->entry) {
+		file->fallback = al_fopen_interface(pack_fallback, path, mode);
+		if (!file->fallback) {
+			free(file);
+			return NULL;
+		}
+	}
+	return file;
+}
+
+static bool PackClose(ALLEGRO_FILE* f) {
+	struct PackFile* file = al_get_file_userdata(f);
+	bool ret = file->fallback ? al_fclose(file->fallback) : true;
+	free(file);
+	return ret;
+}
+
+static size_t PackRead(ALLEGRO_FILE* f, void* ptr, size_t size) {
+	struct PackFile* file = al_get_file_userdata(f);
+	if (file->fallback) {
+		return al_fread(file->fallback, ptr, size);
+	}
+	int64_t left = file->entry->size - file->position;
+	if ((int64_t)size > left) {
+		size = left;
+		file->eof = true;
+	}
+	memcpy(ptr, file->entry->data + file->position, size);
+	file->position += size;
+	return size;
+}
+
+static size_t PackWrite(ALLEGRO_FILE* f, const void* ptr, size_t size) {
+	struct PackFile* file = al_get_file_userdata(f);
+	return file->fallback ? al_fwrite(file->fallback, ptr, size) : 0;
+}
+
+static bool PackFlush(ALLEGRO_FILE* f) {
+	struct PackFile* file = al_get_file_userdata(f);
+	return file->fallback ? al_fflush(file->fallback) : true;
+}
+
+static int64_t PackTell(ALLEGRO_FILE* f) {
+	struct PackFile* file = al_get_file_userdata(f);
+	return file->fallback ? al_ftell(file->fallback) : file->position;
+}
+
+static bool PackSeek(ALLEGRO_FILE* f, int64_t offset, int whence) {
+	struct PackFile* file = al_get_file_userdata(f);
+	if (file->fallback) {
+		return al_fseek(file->fallback, offset, whence);
+	}
+	switch (whence) {
+		case ALLEGRO_SEEK_CUR:
+			offset += file->position;
+			break;
+		case ALLEGRO_SEEK_END:
+			offset += file->entry->size;
+			break;
+	}
+	if (offset < 0 || offset > file->entry->size) {
+		return false;
+	}
+	file->position = offset;
+	file->eof = false;
+	return true;
+}
+
+static bool PackEof(ALLEGRO_FILE* f) {
+	struct PackFile* file = al_get_file_userdata(f);
+	return file->fallback ? al_feof(file->fallback) : file->eof;
+}
+
+static int PackError(ALLEGRO_FILE* f) {
+	struct PackFile* file = al_get_file_userdata(f);
+	return file->fallback ? al_ferror(file->fallback) : 0;
+}
+
+static const char* PackErrorMessage(ALLEGRO_FILE* f) {
+	struct PackFile* file = al_get_file_userdata(f);
+	return file->fallback ? al_ferrmsg(file->fallback) : "";
+}
+
+static void PackClearError(ALLEGRO_FILE* f) {
+	struct PackFile* file = al_get_file_userdata(f);
+	if (file->fallback) {
+		al_fclearerr(file->fallback);
+	} else {
+		file->eof = false;
+	}
+}
+
+static int PackUngetc(ALLEGRO_FILE* f, int c) {
+	struct PackFile* file = al_get_file_userdata(f);
+	if (file->fallback) {
+		return al_fungetc(file->fallback, c);
+	}
+	// the contents are read-only, so only the byte that was just read can be put back
+	if (file->position == 0 || file->entry->data[file->position - 1] != (unsigned char)c) {
+		return EOF;
+	}
+	file->position--;
+	file->eof = false;
+	return c;
+}
+
+static off_t PackSize(ALLEGRO_FILE* f) {
+	struct PackFile* file = al_get_file_userdata(f);
+	return file->fallback ? al_fsize(file->fallback) : file->entry->size;
+}
+
+static const ALLEGRO_FILE_INTERFACE pack_interface = {
+	.fi_fopen = PackOpen,
+	.fi_fclose = PackClose,
+	.fi_fread = PackRead,
+	.fi_fwrite = PackWrite,
+	.fi_fflush = PackFlush,
+	.fi_ftell = PackTell,
+	.fi_fseek = PackSeek,
+	.fi_feof = PackEof,
+	.fi_ferror = PackError,
+	.fi_ferrmsg = PackErrorMessage,
+	.fi_fclearerr = PackClearError,
+	.fi_fungetc = PackUngetc,
+	.fi_fsize = PackSize,
+};
+
+
+// Entries for paths inside the pack; anything else gets an entry of the regular filesystem,
+// which then takes care of it on its own.
+struct PackFsEntry {
+	ALLEGRO_FS_ENTRY base;
+	char* path;
+	const struct PackEntry* entry; // NULL for directories
+};
+
+static ALLEGRO_FS_ENTRY* PackCreateEntry(const char* path) {
+	const struct PackEntry* entry = FindPackEntry(path);
+	if (!entry && !IsPackDirectory(path)) {
+		return pack_fs_fallback->fs_create_entry(path);
+	}
+	struct PackFsEntry* e = calloc(1, sizeof(struct PackFsEntry));
+	e->base.vtable = &pack_fs_interface;
+	e->path = strdup(path);
+	e->entry = entry;
+	return &e->base;
+}
+
+static void PackDestroyEntry(ALLEGRO_FS_ENTRY* fs) {
+	struct PackFsEntry* e = (struct PackFsEntry*)fs;
+	free(e->path);
+	free(e);
+}
+
+static const char* PackEntryName(ALLEGRO_FS_ENTRY* fs) {
+	return ((struct PackFsEntry*)fs)->path;
+}
+
+static bool PackUpdateEntry(ALLEGRO_FS_ENTRY* fs) {
+	return true; // the pack doesn't change while it's mapped
+}
+
+static uint32_t PackEntryMode(ALLEGRO_FS_ENTRY* fs) {
+	struct PackFsEntry* e = (struct PackFsEntry*)fs;
+	return ALLEGRO_FILEMODE_READ | (e->entry ? ALLEGRO_FILEMODE_ISFILE : ALLEGRO_FILEMODE_ISDIR | ALLEGRO_FILEMODE_EXECUTE);
+}
+
+static time_t PackEntryTime(ALLEGRO_FS_ENTRY* fs) {
+	return pack->mtime;
+}
+
+static off_t PackEntrySize(ALLEGRO_FS_ENTRY* fs) {
+	struct PackFsEntry* e = (struct PackFsEntry*)fs;
+	return e->entry ? e->entry->size : 0;
+}
+
+static bool PackEntryExists(ALLEGRO_FS_ENTRY* fs) {
+	return true;
+}
+
+static bool PackRemoveEntry(ALLEGRO_FS_ENTRY* fs) {
+	return false;
+}
+
+// Nothing walks the data directory, so directories in the pack can't be listed.
+static bool PackOpenDirectory(ALLEGRO_FS_ENTRY* fs) {
+	return false;
+}
+
+static ALLEGRO_FS_ENTRY* PackReadDirectory(ALLEGRO_FS_ENTRY* fs) {
+	return NULL;
+}
+
+static bool PackCloseDirectory(ALLEGRO_FS_ENTRY* fs) {
+	return false;
+}
+
+static bool PackFilenameExists(const char* path) {
+	return FindPackEntry(path) || IsPackDirectory(path) || pack_fs_fallback->fs_filename_exists(path);
+}
+
+static bool PackRemoveFilename(const char* path) {
+	return !FindPackEntry(path) && pack_fs_fallback->fs_remove_filename(path);
+}
+
+static char* PackGetCurrentDirectory(void) {
+	return pack_fs_fallback->fs_get_current_directory();
+}
+
+static bool PackChangeDirectory(const char* path) {
+	return pack_fs_fallback->fs_change_directory(path);
+}
+
+static bool PackMakeDirectory(const char* path) {
+	return IsPackDirectory(path) || pack_fs_fallback->fs_make_directory(path);
+}
+
+static ALLEGRO_FILE* PackOpenFile(ALLEGRO_FS_ENTRY* fs, const char* mode) {
+	return al_fopen_interface(&pack_interface, ((struct PackFsEntry*)fs)->path, mode);
+}
+
+// Answers lookups from the index the way allegro_physfs does from its archives, so the engine
+// finds packed files by itself and they don't have to be installed as loose files as well.
+static const ALLEGRO_FS_INTERFACE pack_fs_interface = {
+	.fs_create_entry = PackCreateEntry,
+	.fs_destroy_entry = PackDestroyEntry,
+	.fs_entry_name = PackEntryName,
+	.fs_update_entry = PackUpdateEntry,
+	.fs_entry_mode = PackEntryMode,
+	.fs_entry_atime = PackEntryTime,
+	.fs_entry_mtime = PackEntryTime,
+	.fs_entry_ctime = PackEntryTime,
+	.fs_entry_size = PackEntrySize,
+	.fs_entry_exists = PackEntryExists,
+	.fs_remove_entry = PackRemoveEntry,
+	.fs_open_directory = PackOpenDirectory,
+	.fs_read_directory = PackReadDirectory,
+	.fs_close_directory = PackCloseDirectory,
+	.fs_filename_exists = PackFilenameExists,
+	.fs_remove_filename = PackRemoveFilename,
+	.fs_get_current_directory = PackGetCurrentDirectory,
+	.fs_change_directory = PackChangeDirectory,
+	.fs_make_directory = PackMakeDirectory,
+	.fs_open_file = PackOpenFile,
+};
+
+void UseAssetPack(struct Game* game) {
+	// Both interfaces are thread-local, so every thread that loads data has to switch to them.
+	// From then on all lookups and reads made by it, including the ones done by the engine and
+	// Allegro addons, come from the pack for files that are in there.
+	if (!pack || al_get_new_file_interface() == &pack_interface) {
+		return;
+	}
+	al_set_new_file_interface(&pack_interface);
+	al_set_fs_interface(&pack_fs_interface);
+}
+
+static uint64_t ReadPackInt(const unsigned char* data, int bytes) {
+	uint64_t value = 0;
+	for (int i = bytes - 1; i >= 0; i--) {
+		value = value << 8 | data[i];
+	}
+	return value;
+}
+
+// Maps the whole file read-only. Returns NULL if it can't be mapped or is too short to be a pack.
+static unsigned char* MapFile(const char* path, size_t* length) {
+#if defined(__unix__) || defined(__APPLE__)
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	off_t size = lseek(fd, 0, SEEK_END);
+	unsigned char* map = size >= 32 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+	*length = size;
+	return map;
+#elif defined(_WIN32)
+	wchar_t wpath[MAX_PATH];
+	if (!MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, MAX_PATH)) {
+		return NULL;
+	}
+	HANDLE file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart >= 32 && (uint64_t)size.QuadPart <= SIZE_MAX) {
+		mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	}
+	CloseHandle(file);
+	if (!mapping) {
+		return NULL;
+	}
+	unsigned char* map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping); // the view keeps it alive
+	if (!map) {
+		return NULL;
+	}
+	*length = size.QuadPart;
+	return map;
+#else
+	return NULL;
+#endif
+}
+
+static void UnmapFile(unsigned char* map, size_t length) {
+#if defined(__unix__) || defined(__APPLE__)
+	munmap(map, length);
+#elif defined(_WIN32)
+	UnmapViewOfFile(map);
+#endif
+}
+
+static void MapAssetPack(struct Game* game, const char* path) {
+	size_t length;
+	unsigned char* map = MapFile(path, &length);
+	if (!map) {
+		PrintConsole(game, "Could not map %s!", path);
+		return;
+	}
+
+	uint64_t count = ReadPackInt(map + 8, 4), index = ReadPackInt(map + 16, 8), size = ReadPackInt(map + 24, 8);
+	if (memcmp(map, "ODPK", 4) != 0 || ReadPackInt(map + 4, 4) != PACK_VERSION || index > (uint64_t)length || size > length - index) {
+		PrintConsole(game, "Invalid asset pack %s!", path);
+		UnmapFile(map, length);
+		return;
+	}
+
+	struct AssetPack* p = calloc(1, sizeof(struct AssetPack));
+	p->map = map;
+	p->length = length;
+	p->entries = calloc(count, sizeof(struct PackEntry));
+	p->names = malloc(size); // every name is stored after 20 bytes of entry header, so there's room for the terminators
+	const unsigned char *entry = map + index, *end = map + index + size;
+	char* name = p->names;
+	for (p->count = 0; p->count < (int)count; p->count++) {
+		if (end - entry < 20) {
+			break;
+		}
+		uint64_t offset = ReadPackInt(entry, 8), len = ReadPackInt(entry + 8, 8), namelen = ReadPackInt(entry + 16, 4);
+		if (offset > index || len > index - offset || namelen > (uint64_t)(end - entry - 20)) {
+			break;
+		}
+		memcpy(name, entry + 20, namelen);
+		name[namelen] = '\0';
+		p->entries[p->count] = (struct PackEntry){.path = name, .data = map + offset, .size = len};
+		name += namelen + 1;
+		entry += 20 + namelen;
+	}
+	if (p->count != (int)count) {
+		PrintConsole(game, "Asset pack %s is truncated!", path);
+		UnmapFile(map, length);
+		free(p->entries);
+		free(p->names);
+		free(p);
+		return;
+	}
+	qsort(p->entries, p->count, sizeof(struct PackEntry), ComparePackEntries);
+	p->root = strdup(path);
+	p->root[strlen(path) - strlen("odlot.pack")] = '\0';
+	ALLEGRO_FS_ENTRY* file = al_create_fs_entry(path);
+	p->mtime = al_get_fs_entry_mtime(file);
+	al_destroy_fs_entry(file);
+
+	pack_fallback = al_get_new_file_interface();
+	pack_fs_fallback = al_get_fs_interface();
+	pack = p;
+	game->data->pack = p;
+	UseAssetPack(game);
+	PrintConsole(game, "Asset pack: %d files, %.1f MB", p->count, length / (1024.0 * 1024.0));
+}
+
+void OpenAssetPack(struct Game* game) {
+	// installs have their data in the pack only; turning it off is for comparing with a build tree
+	if (!strtol(GetConfigOptionDefault(game, "odlot", "pack", "1"), NULL, 10)) {
+		return;
+	}
+	char* path = FindDataFilePath(game, "odlot.pack");
+	if (path) {
+		MapAssetPack(game, path);
+		free(path);
+	}
+}
+
+void CloseAssetPack(struct Game* game) {
+	struct AssetPack* p = game->data->pack;
+	if (!p) {
+		return;
+	}
+	// everything read from the pack has been released by now, and no other thread is loading anymore
+	al_set_new_file_interface(pack_fallback);
+	al_set_fs_interface(pack_fs_fallback);
+	pack = NULL;
+	game->data->pack = NULL;
+	UnmapFile(p->map, p->length);
+	free(p->entries);
+	free(p->names);
+	free(p->root);
+	free(p);
+}
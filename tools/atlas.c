@@ -0,0 +1,159 @@
+/*! \file atlas.c
+ *  \brief Packs frames of a spritesheet into a single atlas bitmap.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: odlot-atlas <max page size> <input.ini> <output.ini>
+//
+// Loads every frame listed in the input spritesheet, lays them out on a grid
+// no larger than the given page size and writes the atlas next to the output
+// .ini, which gets rewritten to reference grid cells instead of separate files.
+// Spritesheets that don't fit (or have nothing to pack) are copied unchanged.
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char* GetSiblingPath(const char* path, const char* filename) {
+	ALLEGRO_PATH* p = al_create_path(path);
+	al_set_path_filename(p, filename);
+	char* result = strdup(al_path_cstr(p, ALLEGRO_NATIVE_PATH_SEP));
+	al_destroy_path(p);
+	return result;
+}
+
+static int Copy(ALLEGRO_CONFIG* config, const char* output) {
+	return al_save_config_file(output, config) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	if (argc != 4) {
+		fprintf(stderr, "Usage: %s <max page size> <input.ini> <output.ini>\n", argv[0]);
+		return 1;
+	}
+
+	int max = strtol(argv[1], NULL, 10);
+	const char* input = argv[2];
+	const char* output = argv[3];
+
+	if (!al_init() || !al_init_image_addon()) {
+		fprintf(stderr, "Could not initialize Allegro!\n");
+		return 1;
+	}
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+	ALLEGRO_CONFIG* config = al_load_config_file(input);
+	if (!config) {
+		fprintf(stderr, "Could not load %s!\n", input);
+		return 1;
+	}
+
+	const char* count = al_get_config_value(config, "animation", "frames");
+	int frames = count ? strtol(count, NULL, 10) : 0;
+	if (frames < 2 || al_get_config_value(config, "animation", "file")) {
+		return Copy(config, output);
+	}
+
+	ALLEGRO_BITMAP** bitmaps = calloc(frames, sizeof(ALLEGRO_BITMAP*));
+	int width = 0, height = 0;
+	for (int i = 0; i < frames; i++) {
+		char section[16];
+		snprintf(section, sizeof(section), "frame%d", i);
+		const char* file = al_get_config_value(config, section, "file");
+		if (!file) {
+			return Copy(config, output);
+		}
+		char* path = GetSiblingPath(input, file);
+		// keep the alpha straight, so the saved atlas doesn't get premultiplied twice when loaded
+		bitmaps[i] = al_load_bitmap_flags(path, ALLEGRO_NO_PREMULTIPLIED_ALPHA);
+		if (!bitmaps[i]) {
+			fprintf(stderr, "Could not load %s!\n", path);
+			return 1;
+		}
+		free(path);
+		if (al_get_bitmap_width(bitmaps[i]) > width) {
+			width = al_get_bitmap_width(bitmaps[i]);
+		}
+		if (al_get_bitmap_height(bitmaps[i]) > height) {
+			height = al_get_bitmap_height(bitmaps[i]);
+		}
+	}
+
+	// pick the grid with the smallest area that still fits in a page
+	int cols = 0, rows = 0;
+	for (int c = 1; c <= frames; c++) {
+		int r = (frames + c - 1) / c;
+		if (c * width > max || r * height > max) {
+			continue;
+		}
+		if (!cols || c * width * r * height < cols * width * rows * height) {
+			cols = c;
+			rows = r;
+		}
+	}
+	if (!cols) {
+		printf("%s: %d frames of %dx%d don't fit in a %dx%d page, leaving as is\n", input, frames, width, height, max, max);
+		return Copy(config, output);
+	}
+
+	ALLEGRO_BITMAP* atlas = al_create_bitmap(cols * width, rows * height);
+	al_set_target_bitmap(atlas);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+
+	for (int i = 0; i < frames; i++) {
+		char section[16], value[16];
+		snprintf(section, sizeof(section), "frame%d", i);
+		int col = i % cols, row = i / cols;
+		al_draw_bitmap(bitmaps[i], col * width + (width - al_get_bitmap_width(bitmaps[i])) / 2,
+			row * height + (height - al_get_bitmap_height(bitmaps[i])) / 2, 0);
+		al_destroy_bitmap(bitmaps[i]);
+
+		al_remove_config_key(config, section, "file");
+		snprintf(value, sizeof(value), "%d", col);
+		al_set_config_value(config, section, "col", value);
+		snprintf(value, sizeof(value), "%d", row);
+		al_set_config_value(config, section, "row", value);
+	}
+	free(bitmaps);
+
+	ALLEGRO_PATH* path = al_create_path(output);
+	char filename[255];
+	snprintf(filename, sizeof(filename), "%s_atlas.png", al_get_path_basename(path));
+	al_set_path_filename(path, filename);
+	if (!al_save_bitmap(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP), atlas)) {
+		fprintf(stderr, "Could not save %s!\n", al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+		return 1;
+	}
+	al_destroy_path(path);
+	al_destroy_bitmap(atlas);
+
+	char value[16];
+	al_set_config_value(config, "animation", "file", filename);
+	snprintf(value, sizeof(value), "%d", cols);
+	al_set_config_value(config, "animation", "cols", value);
+	snprintf(value, sizeof(value), "%d", rows);
+	al_set_config_value(config, "animation", "rows", value);
+
+	printf("%s: packed %d frames into a %dx%d atlas\n", input, frames, cols * width, rows * height);
+	int ret = Copy(config, output);
+	al_destroy_config(config);
+	return ret;
+}
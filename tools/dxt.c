@@ -0,0 +1,184 @@
+/*! \file dxt.c
+ *  \brief Converts opaque images into DXT1 (BC1) compressed DDS files.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: odlot-dxt <input image> <output.dds>
+//
+// Encodes every 4x4 block with endpoints taken from its (slightly inset) color
+// bounding box, which is plenty for camera photos and takes no time at all.
+// Alpha is dropped, so it's only meant for the JPEG frames.
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint16_t Pack565(const int c[3]) {
+	return ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3);
+}
+
+static void Unpack565(uint16_t p, int c[3]) {
+	c[0] = ((p >> 11) & 31) * 255 / 31;
+	c[1] = ((p >> 5) & 63) * 255 / 63;
+	c[2] = (p & 31) * 255 / 31;
+}
+
+static void EncodeBlock(const unsigned char block[16][3], unsigned char out[8]) {
+	int min[3] = {255, 255, 255}, max[3] = {0, 0, 0};
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) {
+			if (block[i][c] < min[c]) {
+				min[c] = block[i][c];
+			}
+			if (block[i][c] > max[c]) {
+				max[c] = block[i][c];
+			}
+		}
+	}
+	// pull the endpoints a bit inwards, so the interpolated colors cover the block better
+	for (int c = 0; c < 3; c++) {
+		int inset = (max[c] - min[c]) / 16;
+		min[c] += inset;
+		max[c] -= inset;
+	}
+
+	uint16_t c0 = Pack565(max), c1 = Pack565(min);
+	uint32_t indices = 0;
+	if (c0 != c1) {
+		if (c0 < c1) {
+			// four-color mode needs the first endpoint to be the bigger one
+			uint16_t tmp = c0;
+			c0 = c1;
+			c1 = tmp;
+		}
+		int palette[4][3];
+		Unpack565(c0, palette[0]);
+		Unpack565(c1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; i++) {
+			int best = 0, distance = INT32_MAX;
+			for (int j = 0; j < 4; j++) {
+				int d = 0;
+				for (int c = 0; c < 3; c++) {
+					d += (block[i][c] - palette[j][c]) * (block[i][c] - palette[j][c]);
+				}
+				if (d < distance) {
+					distance = d;
+					best = j;
+				}
+			}
+			indices |= (uint32_t)best << (i * 2);
+		}
+	}
+
+	out[0] = c0 & 0xff;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xff;
+	out[3] = c1 >> 8;
+	for (int i = 0; i < 4; i++) {
+		out[4 + i] = (indices >> (i * 8)) & 0xff;
+	}
+}
+
+static void WriteInt(FILE* file, uint32_t value) {
+	unsigned char bytes[4] = {value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, value >> 24};
+	fwrite(bytes, 1, 4, file);
+}
+
+int main(int argc, char** argv) {
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <input image> <output.dds>\n", argv[0]);
+		return 1;
+	}
+
+	if (!al_init() || !al_init_image_addon()) {
+		fprintf(stderr, "Could not initialize Allegro!\n");
+		return 1;
+	}
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+	ALLEGRO_BITMAP* bitmap = al_load_bitmap(argv[1]);
+	if (!bitmap) {
+		fprintf(stderr, "Could not load %s!\n", argv[1]);
+		return 1;
+	}
+	int width = al_get_bitmap_width(bitmap), height = al_get_bitmap_height(bitmap);
+	int bw = (width + 3) / 4, bh = (height + 3) / 4;
+
+	ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+	unsigned char* blocks = malloc(bw * bh * 8);
+	for (int by = 0; by < bh; by++) {
+		for (int bx = 0; bx < bw; bx++) {
+			unsigned char block[16][3];
+			for (int i = 0; i < 16; i++) {
+				// repeat the edge pixels when the size isn't a multiple of four
+				int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+				if (x >= width) {
+					x = width - 1;
+				}
+				if (y >= height) {
+					y = height - 1;
+				}
+				unsigned char* pixel = (unsigned char*)region->data + y * region->pitch + x * 4;
+				memcpy(block[i], pixel, 3);
+			}
+			EncodeBlock(block, blocks + (by * bw + bx) * 8);
+		}
+	}
+	al_unlock_bitmap(bitmap);
+	al_destroy_bitmap(bitmap);
+
+	FILE* file = fopen(argv[2], "wb");
+	if (!file) {
+		fprintf(stderr, "Could not open %s for writing!\n", argv[2]);
+		return 1;
+	}
+	fwrite("DDS ", 1, 4, file);
+	WriteInt(file, 124); // header size
+	WriteInt(file, 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000); // caps, height, width, pixel format, linear size
+	WriteInt(file, height);
+	WriteInt(file, width);
+	WriteInt(file, bw * bh * 8);
+	WriteInt(file, 0); // depth
+	WriteInt(file, 0); // mipmaps
+	for (int i = 0; i < 11; i++) {
+		WriteInt(file, 0); // reserved
+	}
+	WriteInt(file, 32); // pixel format size
+	WriteInt(file, 0x4); // FourCC
+	fwrite("DXT1", 1, 4, file);
+	for (int i = 0; i < 5; i++) {
+		WriteInt(file, 0); // bit masks
+	}
+	WriteInt(file, 0x1000); // texture
+	for (int i = 0; i < 4; i++) {
+		WriteInt(file, 0); // caps2-4, reserved
+	}
+	fwrite(blocks, 1, bw * bh * 8, file);
+	fclose(file);
+	free(blocks);
+
+	printf("%s: %dx%d, %d KB\n", argv[2], width, height, bw * bh * 8 / 1024);
+	return 0;
+}
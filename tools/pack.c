@@ -0,0 +1,252 @@
+/*! \file pack.c
+ *  \brief Bundles the game data into a single indexed archive.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: odlot-pack [-l <list>] <output.pack> <order file> <data dir>[=<prefix>]...
+//
+// Every file found under the data directories is stored under its path relative
+// to the directory it came from, with the prefix (if given) in front; files in
+// later directories replace the ones with the same path from earlier ones (that's
+// how build outputs override the sources). The order file lists glob patterns, one per line; files are stored
+// in the order of the first pattern they match, so data of a scene sits next to
+// each other and the scenes follow the order they're played in. Files matching
+// no pattern go last. Lines starting with '!' exclude files from the pack,
+// lines starting with '#' are comments. With -l, the paths of the packed files
+// are written to the list file, one per line, so the install can leave them out.
+//
+// Layout (little endian):
+//   "ODPK", u32 version, u32 count, u32 reserved, u64 index offset, u64 index size
+//   file contents, each aligned to PACK_ALIGNMENT
+//   index: for every file u64 offset, u64 size, u32 path length, path
+
+#include <allegro5/allegro.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PACK_VERSION 1
+#define PACK_ALIGNMENT 64
+
+struct File {
+	char* path; // relative, with '/' separators
+	char* source;
+	int rank;
+};
+
+static char** patterns = NULL;
+static int pattern_count = 0;
+
+static struct File* files = NULL;
+static int file_count = 0;
+
+static bool Match(const char* pattern, const char* path) {
+	if (*pattern == '\0') {
+		return *path == '\0';
+	}
+	if (*pattern == '*') {
+		for (const char* p = path;; p++) {
+			if (Match(pattern + 1, p)) {
+				return true;
+			}
+			if (*p == '\0') {
+				return false;
+			}
+		}
+	}
+	if (*path == '\0') {
+		return false;
+	}
+	return (*pattern == '?' || *pattern == *path) && Match(pattern + 1, path + 1);
+}
+
+static int Rank(const char* path) {
+	for (int i = 0; i < pattern_count; i++) {
+		if (patterns[i][0] == '!') {
+			if (Match(patterns[i] + 1, path)) {
+				return -1;
+			}
+		} else if (Match(patterns[i], path)) {
+			return i;
+		}
+	}
+	return pattern_count;
+}
+
+static void AddFile(const char* path, const char* source) {
+	int rank = Rank(path);
+	for (int i = 0; i < file_count; i++) {
+		if (strcmp(files[i].path, path) == 0) {
+			free(files[i].source);
+			files[i].source = strdup(source);
+			return;
+		}
+	}
+	if (rank < 0) {
+		return;
+	}
+	files = realloc(files, (file_count + 1) * sizeof(struct File));
+	files[file_count].path = strdup(path);
+	files[file_count].source = strdup(source);
+	files[file_count].rank = rank;
+	file_count++;
+}
+
+static void Scan(ALLEGRO_FS_ENTRY* dir, const char* prefix) {
+	if (!al_open_directory(dir)) {
+		return;
+	}
+	ALLEGRO_FS_ENTRY* entry;
+	while ((entry = al_read_directory(dir))) {
+		// entry names come without a trailing separator, so directories end up as the filename too
+		ALLEGRO_PATH* path = al_create_path(al_get_fs_entry_name(entry));
+		char relative[1024];
+		snprintf(relative, sizeof(relative), "%s%s", prefix, al_get_path_filename(path));
+		if (al_get_fs_entry_mode(entry) & ALLEGRO_FILEMODE_ISDIR) {
+			strncat(relative, "/", sizeof(relative) - strlen(relative) - 1);
+			Scan(entry, relative);
+		} else {
+			AddFile(relative, al_get_fs_entry_name(entry));
+		}
+		al_destroy_path(path);
+		al_destroy_fs_entry(entry);
+	}
+	al_close_directory(dir);
+}
+
+static int CompareFiles(const void* a, const void* b) {
+	const struct File *x = a, *y = b;
+	if (x->rank != y->rank) {
+		return x->rank - y->rank;
+	}
+	return strcmp(x->path, y->path);
+}
+
+static void WriteInt(FILE* file, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) {
+		fputc((value >> (i * 8)) & 0xff, file);
+	}
+}
+
+int main(int argc, char** argv) {
+	const char* list = NULL;
+	if (argc > 2 && strcmp(argv[1], "-l") == 0) {
+		list = argv[2];
+		argv += 2;
+		argc -= 2;
+	}
+	if (argc < 4) {
+		fprintf(stderr, "Usage: %s [-l <list>] <output.pack> <order file> <data dir>[=<prefix>]...\n", argv[0]);
+		return 1;
+	}
+
+	if (!al_init()) {
+		fprintf(stderr, "Could not initialize Allegro!\n");
+		return 1;
+	}
+
+	FILE* order = fopen(argv[2], "r");
+	if (!order) {
+		fprintf(stderr, "Could not open %s!\n", argv[2]);
+		return 1;
+	}
+	char line[1024];
+	while (fgets(line, sizeof(line), order)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '\0' || line[0] == '#') {
+			continue;
+		}
+		patterns = realloc(patterns, (pattern_count + 1) * sizeof(char*));
+		patterns[pattern_count++] = strdup(line);
+	}
+	fclose(order);
+
+	for (int i = 3; i < argc; i++) {
+		char* prefix = strchr(argv[i], '=');
+		if (prefix) {
+			*prefix++ = '\0';
+		}
+		ALLEGRO_FS_ENTRY* dir = al_create_fs_entry(argv[i]);
+		Scan(dir, prefix ? prefix : "");
+		al_destroy_fs_entry(dir);
+	}
+	// stable, as ties are broken by path
+	qsort(files, file_count, sizeof(struct File), CompareFiles);
+
+	FILE* output = fopen(argv[1], "wb");
+	if (!output) {
+		fprintf(stderr, "Could not open %s for writing!\n", argv[1]);
+		return 1;
+	}
+	fwrite("ODPK", 1, 4, output);
+	WriteInt(output, PACK_VERSION, 4);
+	WriteInt(output, file_count, 4);
+	WriteInt(output, 0, 4);
+	WriteInt(output, 0, 8); // index offset and size, filled in at the end
+	WriteInt(output, 0, 8);
+
+	uint64_t* offsets = calloc(file_count, sizeof(uint64_t));
+	uint64_t* sizes = calloc(file_count, sizeof(uint64_t));
+	char buffer[65536];
+	for (int i = 0; i < file_count; i++) {
+		while (ftell(output) % PACK_ALIGNMENT) {
+			fputc(0, output);
+		}
+		offsets[i] = ftell(output);
+		FILE* input = fopen(files[i].source, "rb");
+		if (!input) {
+			fprintf(stderr, "Could not open %s!\n", files[i].source);
+			return 1;
+		}
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), input))) {
+			fwrite(buffer, 1, read, output);
+			sizes[i] += read;
+		}
+		fclose(input);
+	}
+
+	uint64_t index = ftell(output);
+	for (int i = 0; i < file_count; i++) {
+		WriteInt(output, offsets[i], 8);
+		WriteInt(output, sizes[i], 8);
+		WriteInt(output, strlen(files[i].path), 4);
+		fwrite(files[i].path, 1, strlen(files[i].path), output);
+	}
+	uint64_t end = ftell(output);
+	fseek(output, 16, SEEK_SET);
+	WriteInt(output, index, 8);
+	WriteInt(output, end - index, 8);
+	fclose(output);
+
+	if (list) {
+		FILE* paths = fopen(list, "w");
+		if (!paths) {
+			fprintf(stderr, "Could not open %s for writing!\n", list);
+			return 1;
+		}
+		for (int i = 0; i < file_count; i++) {
+			fprintf(paths, "%s\n", files[i].path);
+		}
+		fclose(paths);
+	}
+
+	printf("%s: %d files, %.1f MB\n", argv[1], file_count, end / (1024.0 * 1024.0));
+	return 0;
+}
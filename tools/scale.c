@@ -0,0 +1,95 @@
+/*! \file scale.c
+ *  \brief Produces downscaled variants of images for lower resolution tiers.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: odlot-scale <divisor> <input image> <output image>
+//
+// Averages every divisor x divisor block of pixels into one. Colors are
+// weighted by alpha, so transparent pixels don't darken the edges of sprites.
+// The output format is picked from the extension, like the input one.
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char** argv) {
+	if (argc != 4) {
+		fprintf(stderr, "Usage: %s <divisor> <input image> <output image>\n", argv[0]);
+		return 1;
+	}
+
+	int divisor = strtol(argv[1], NULL, 10);
+	if (divisor < 1) {
+		fprintf(stderr, "Invalid divisor %s!\n", argv[1]);
+		return 1;
+	}
+
+	if (!al_init() || !al_init_image_addon()) {
+		fprintf(stderr, "Could not initialize Allegro!\n");
+		return 1;
+	}
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+	// straight alpha in and out, as that's what gets saved
+	ALLEGRO_BITMAP* bitmap = al_load_bitmap_flags(argv[2], ALLEGRO_NO_PREMULTIPLIED_ALPHA);
+	if (!bitmap) {
+		fprintf(stderr, "Could not load %s!\n", argv[2]);
+		return 1;
+	}
+	int width = al_get_bitmap_width(bitmap), height = al_get_bitmap_height(bitmap);
+	int w = (width + divisor - 1) / divisor, h = (height + divisor - 1) / divisor;
+
+	ALLEGRO_BITMAP* scaled = al_create_bitmap(w, h);
+	ALLEGRO_LOCKED_REGION* src = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+	ALLEGRO_LOCKED_REGION* dst = al_lock_bitmap(scaled, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			long color[3] = {0, 0, 0}, alpha = 0;
+			int count = 0;
+			for (int sy = y * divisor; sy < (y + 1) * divisor && sy < height; sy++) {
+				for (int sx = x * divisor; sx < (x + 1) * divisor && sx < width; sx++) {
+					unsigned char* pixel = (unsigned char*)src->data + sy * src->pitch + sx * 4;
+					for (int c = 0; c < 3; c++) {
+						color[c] += pixel[c] * pixel[3];
+					}
+					alpha += pixel[3];
+					count++;
+				}
+			}
+			unsigned char* pixel = (unsigned char*)dst->data + y * dst->pitch + x * 4;
+			for (int c = 0; c < 3; c++) {
+				pixel[c] = alpha ? (color[c] + alpha / 2) / alpha : 0;
+			}
+			pixel[3] = (alpha + count / 2) / count;
+		}
+	}
+	al_unlock_bitmap(scaled);
+	al_unlock_bitmap(bitmap);
+	al_destroy_bitmap(bitmap);
+
+	if (!al_save_bitmap(argv[3], scaled)) {
+		fprintf(stderr, "Could not save %s!\n", argv[3]);
+		return 1;
+	}
+	al_destroy_bitmap(scaled);
+
+	printf("%s: %dx%d\n", argv[3], w, h);
+	return 0;
+}